@@ -0,0 +1,56 @@
+#include "CAENBackend.hh"
+#include <CAENVMElib.h>
+
+int CAENBackend::Init(int link, int crate, int& handle) {
+  return CAENVME_Init(cvV2718, link, crate, &handle);
+}
+
+int CAENBackend::End(int handle) {
+  return CAENVME_End(handle);
+}
+
+int CAENBackend::ReadRegister(int handle, uint32_t address, uint32_t& value) {
+  return CAENVME_ReadCycle(handle, address, &value, cvA32_U_DATA, cvD32);
+}
+
+int CAENBackend::WriteRegister(int handle, uint32_t address, uint32_t value) {
+  return CAENVME_WriteCycle(handle, address, &value, cvA32_U_DATA, cvD32);
+}
+
+int CAENBackend::BLTRead(int handle, uint32_t address, void* buffer, int size, int& bytes) {
+  return CAENVME_FIFOBLTReadCycle(handle, address, (unsigned char*)buffer, size,
+      cvA32_U_MBLT, cvD64, &bytes);
+}
+
+int CAENBackend::IRQEnable(int handle, uint32_t mask) {
+  return CAENVME_IRQEnable(handle, mask);
+}
+
+int CAENBackend::IRQWait(int handle, uint32_t mask, uint32_t timeout_ms) {
+  return CAENVME_IRQWait(handle, mask, timeout_ms);
+}
+
+int CAENBackend::SetOutputConf(int handle, int output, OutputSource source) {
+  if (output < 0 || output > 4) return kGenericError;
+  return CAENVME_SetOutputConf(handle, CVOutputSelect(cvOutput0 + output), cvDirect,
+      cvActiveHigh, source == kMiscSignals ? cvMiscSignals : cvManualSW);
+}
+
+int CAENBackend::SetOutputRegister(int handle, uint32_t outputs) {
+  const unsigned bits[] = {cvOut0Bit, cvOut1Bit, cvOut2Bit, cvOut3Bit, cvOut4Bit};
+  unsigned short data = 0;
+  for (int i = 0; i < 5; i++) if (outputs & (1 << i)) data |= bits[i];
+  return CAENVME_SetOutputRegister(handle, data);
+}
+
+int CAENBackend::StartPulser(int handle, uint32_t period, uint32_t width, TimeUnit unit) {
+  const CVTimeUnits units[] = {cvUnit25ns, cvUnit1600ns, cvUnit410us, cvUnit104ms};
+  int ret = CAENVME_SetPulserConf(handle, cvPulserB, period, width, units[unit], 0,
+      cvManualSW, cvManualSW);
+  if (ret != cvSuccess) return ret;
+  return CAENVME_StartPulser(handle, cvPulserB);
+}
+
+int CAENBackend::StopPulser(int handle) {
+  return CAENVME_StopPulser(handle, cvPulserB);
+}
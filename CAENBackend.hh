@@ -0,0 +1,25 @@
+#ifndef _CAENBACKEND_HH_
+#define _CAENBACKEND_HH_
+
+#include "VMEBackend.hh"
+
+class CAENBackend : public VMEBackend{
+  /*
+    The real thing: CAENVMElib through a V2718 or an A3818 optical link
+  */
+
+public:
+  virtual int Init(int link, int crate, int& handle);
+  virtual int End(int handle);
+  virtual int ReadRegister(int handle, uint32_t address, uint32_t& value);
+  virtual int WriteRegister(int handle, uint32_t address, uint32_t value);
+  virtual int BLTRead(int handle, uint32_t address, void* buffer, int size, int& bytes);
+  virtual int IRQEnable(int handle, uint32_t mask);
+  virtual int IRQWait(int handle, uint32_t mask, uint32_t timeout_ms);
+  virtual int SetOutputConf(int handle, int output, OutputSource);
+  virtual int SetOutputRegister(int handle, uint32_t outputs);
+  virtual int StartPulser(int handle, uint32_t period, uint32_t width, TimeUnit);
+  virtual int StopPulser(int handle);
+};
+
+#endif // _CAENBACKEND_HH_ defined
@@ -0,0 +1,109 @@
+#include "CBLTChain.hh"
+#include "V1724.hh"
+#include "f1724.hh"
+#include "VMEBackend.hh"
+#include "HeaderScan.hh"
+#include "MongoLog.hh"
+#include "Options.hh"
+#include "StraxFormatter.hh"
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+CBLTChain::CBLTChain(std::vector<std::shared_ptr<V1724>>& boards, std::shared_ptr<Options>& opts,
+    std::shared_ptr<MongoLog>& log, int link, int crate) {
+  fLog = log;
+  fHandle = -1;
+  fStrayWords = 0;
+  if (boards.size() < 2 || boards.size() > kMaxBoards)
+    throw std::runtime_error("CBLT needs between 2 and 32 boards, not " + std::to_string(boards.size()));
+  for (auto& b : boards) {
+    if (std::dynamic_pointer_cast<f1724>(b))
+      throw std::runtime_error("Can't chain fake board " + std::to_string(b->bid()));
+  }
+  fBoards = boards;
+  unsigned address = opts->GetInt("cblt_address", 0xAA) & 0xFF;
+  fAddress = address << 24;
+  fBLTSize = opts->GetInt("blt_size", 512*1024);
+  fBuffer.resize(fBLTSize/sizeof(char32_t)*opts->GetDouble("blt_safety_factor", 1.5));
+
+  fVME = VMEBackend::Get(opts);
+  if (fVME->Init(link, crate, fHandle) != VMEBackend::kSuccess) {
+    fHandle = -1;
+    throw std::runtime_error("Can't open link " + std::to_string(link) + " crate " +
+        std::to_string(crate) + " for CBLT");
+  }
+  for (unsigned i = 0; i < fBoards.size(); i++) {
+    // 10 first, 11 somewhere in between, 01 last
+    unsigned position = i == 0 ? 0x2 : (i+1 == fBoards.size() ? 0x1 : 0x3);
+    if (fBoards[i]->WriteRegister(kBoardIDRegister, i) ||
+        fBoards[i]->WriteRegister(kChainRegister, address | (position << 8))) {
+      // no destructor after a throw, so undo what we did here
+      for (unsigned j = 0; j <= i; j++) fBoards[j]->WriteRegister(kChainRegister, 0);
+      fVME->End(fHandle);
+      throw std::runtime_error("Can't add board " + std::to_string(fBoards[i]->bid()) +
+          " to the CBLT chain");
+    }
+  }
+  fLog->Entry(MongoLog::Local, "CBLT chain of %i boards at 0x%08x on link %i crate %i",
+      fBoards.size(), fAddress, link, crate);
+}
+
+CBLTChain::~CBLTChain() {
+  for (auto& b : fBoards) b->WriteRegister(kChainRegister, 0);
+  if (fHandle >= 0) fVME->End(fHandle);
+  if (fStrayWords > 0)
+    fLog->Entry(MongoLog::Local, "CBLT chain dropped %li words from no board in it", fStrayWords);
+  if (fBLTCounter.empty()) return;
+  std::stringstream msg;
+  msg << "BLT report for CBLT chain at " << std::hex << fAddress << std::dec << " (BLT " << fBLTSize << ")";
+  for (auto p : fBLTCounter) msg << " | " << p.first << " " << int(std::log2(p.second));
+  fLog->Entry(MongoLog::Local, msg.str());
+}
+
+int CBLTChain::Read(std::list<std::unique_ptr<data_packet>>& out) {
+  // what didn't make a whole event last time comes first
+  std::u32string data;
+  data.swap(fTail);
+  size_t carried = data.size();
+  int count = 0, nb = 0, ret;
+  do {
+    ret = fVME->BLTRead(fHandle, fAddress, fBuffer.data(), fBLTSize, nb);
+    if (ret != VMEBackend::kSuccess && ret != VMEBackend::kBusError) {
+      fLog->Entry(MongoLog::Error, "CBLT read error after %i reads: (%i) and transferred %i bytes this read",
+          count, ret, nb);
+      return -1;
+    }
+    count++;
+    data.append(fBuffer.data(), nb/sizeof(char32_t));
+  } while (ret != VMEBackend::kBusError && count < kMaxBLTs);
+  if (data.empty()) return 0;
+  fBLTCounter[count]++;
+
+  // The boards send one after the other so each one's events are all in a
+  // row, but there's no harm in not counting on that
+  std::vector<std::u32string> per_board(fBoards.size());
+  size_t n = data.size(), idx = 0, next;
+  while ((next = HeaderScan::NextEvent(data.data(), n, idx)) < n) {
+    fStrayWords += next - idx;
+    uint32_t words = data[next]&0xFFFFFFF;
+    unsigned id = (data[next+1]>>27)&0x1F;
+    if (id < fBoards.size())
+      per_board[id].append(data, next, words);
+    else
+      fStrayWords += words;
+    idx = next + words;
+  }
+  if (ret == VMEBackend::kBusError)
+    fStrayWords += n - idx;
+  else
+    fTail.assign(data, idx, n - idx); // we stopped, the boards didn't
+  for (unsigned i = 0; i < fBoards.size(); i++) {
+    if (per_board[i].empty()) continue;
+    std::unique_ptr<data_packet> dp;
+    fBoards[i]->MakePacket(std::move(per_board[i]), dp);
+    dp->digi = fBoards[i];
+    out.emplace_back(std::move(dp));
+  }
+  return n - carried;
+}
@@ -0,0 +1,59 @@
+#ifndef _CBLTCHAIN_HH_
+#define _CBLTCHAIN_HH_
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <list>
+#include <memory>
+#include <string>
+
+class MongoLog;
+class Options;
+class V1724;
+class VMEBackend;
+struct data_packet;
+
+class CBLTChain{
+  /*
+    Chained block transfer for the boards of one crate. Each board gets told
+    where in the chain it sits and its position as board ID, which goes into
+    the header of every event it sends. A read is then one BLT (or a few) at
+    the chain's address, the boards taking turns to send what they have, with
+    the bus error coming from the last one. Afterwards the data gets split
+    back up by board ID and goes through the board it came from like any
+    other read, so one transfer setup per crate instead of a status poll and
+    a transfer per board.
+  */
+
+public:
+  // Boards in chain order. Throws if the chain can't be set up
+  CBLTChain(std::vector<std::shared_ptr<V1724>>&, std::shared_ptr<Options>&,
+      std::shared_ptr<MongoLog>&, int link, int crate);
+  ~CBLTChain();
+
+  // One packet per board that had data. Returns words read, <0 on error
+  int Read(std::list<std::unique_ptr<data_packet>>&);
+  const std::vector<std::shared_ptr<V1724>>& GetBoards() {return fBoards;}
+
+  static const unsigned kMaxBoards = 32; // 5 bits of board ID
+  static const int kBoardIDRegister = 0xEF08;
+  static const int kChainRegister = 0xEF0C;
+  // per read, so one read can't go on forever while the boards keep filling
+  // up faster than we can empty them
+  static const int kMaxBLTs = 64;
+
+private:
+  std::vector<std::shared_ptr<V1724>> fBoards; // index is the board ID in the headers
+  std::shared_ptr<VMEBackend> fVME;
+  std::shared_ptr<MongoLog> fLog;
+  int fHandle;
+  uint32_t fAddress;
+  int fBLTSize;
+  std::vector<char32_t> fBuffer;
+  std::u32string fTail; // the start of an event we didn't get all of yet
+  std::map<int, long> fBLTCounter;
+  long fStrayWords; // not in an event from a board we know
+};
+
+#endif // _CBLTCHAIN_HH_ defined
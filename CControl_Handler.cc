@@ -55,7 +55,7 @@ int CControl_Handler::Arm(std::shared_ptr<Options>& opts){
   }
   BoardType cc_def = bv[0];
   try{
-    fV2718 = std::make_unique<V2718>(fLog, copts, cc_def.link, cc_def.crate);
+    fV2718 = std::make_unique<V2718>(fLog, fOptions, copts, cc_def.link, cc_def.crate);
   }catch(std::exception& e){
     fLog->Entry(MongoLog::Error, "Failed to initialize V2718 crate controller: %s", e.what());
     fStatus = DAXHelpers::Idle;
@@ -0,0 +1,93 @@
+#include "ChannelPrescaler.hh"
+#include "MongoLog.hh"
+#include "Options.hh"
+#include <chrono>
+#include <algorithm>
+
+static long SteadyNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ChannelPrescaler::ChannelPrescaler(std::shared_ptr<Options>& opts, std::shared_ptr<MongoLog>& log) {
+  fLog = log;
+  fFactor = std::make_unique<std::atomic_int[]>(kMaxChannels);
+  for (int i = 0; i < kMaxChannels; i++) fFactor[i] = 1;
+  for (auto& [ch, factor] : opts->GetChannelPrescales()) {
+    if (ch < 0 || ch >= kMaxChannels || factor < 0) {
+      fLog->Entry(MongoLog::Warning, "Ignoring prescale %i for channel %i", factor, ch);
+      continue;
+    }
+    fConfigured[ch] = factor;
+    fFactor[ch] = factor;
+    fLog->Entry(MongoLog::Local, "Channel %i prescaled by %i", ch, factor);
+  }
+  fLimit = opts->GetDouble("hot_channel_limit", 0)*1e6;
+  fRestore = fLimit*opts->GetDouble("hot_channel_restore_fraction", 0.5);
+  fHoldoff = std::max(1, opts->GetInt("hot_channel_seconds", 5));
+  fGuardAction = opts->GetString("hot_channel_action", "prescale");
+  fGuardFactor = std::max(2, opts->GetInt("hot_channel_prescale", 10));
+  if (fGuardAction != "prescale" && fGuardAction != "mask") {
+    fLog->Entry(MongoLog::Warning, "Unknown hot_channel_action %s, will prescale",
+        fGuardAction.c_str());
+    fGuardAction = "prescale";
+  }
+  fLastUpdate = SteadyNow();
+}
+
+ChannelPrescaler::~ChannelPrescaler() {
+  fFactor.reset();
+}
+
+void ChannelPrescaler::Update(const std::map<int, int>& bytes_per_channel) {
+  long now = SteadyNow();
+  double seconds = (now - fLastUpdate)*1e-9;
+  fLastUpdate = now;
+  if (fLimit <= 0 || seconds <= 0) return;
+  // channels that have gone quiet still need their counters looked at
+  std::map<int, double> rates;
+  for (auto& [ch, n] : fHot) rates[ch] = 0;
+  for (int ch = 0; ch < kMaxChannels; ch++)
+    if (fFactor[ch] != 1) rates[ch] = 0;
+  for (auto& [ch, bytes] : bytes_per_channel) rates[ch] = bytes/seconds;
+
+  for (auto& [ch, rate] : rates) {
+    if (ch < 0 || ch >= kMaxChannels) continue;
+    int configured = fConfigured.count(ch) ? fConfigured[ch] : 1;
+    int current = fFactor[ch];
+    if (current == configured) {
+      // not touched by the guard (yet)
+      if (rate <= fLimit || configured == 0) {
+        fHot.erase(ch);
+        continue;
+      }
+      if (++fHot[ch] < fHoldoff) continue;
+      fHot.erase(ch);
+      int factor = fGuardAction == "mask" ? 0 : fGuardFactor*configured;
+      fFactor[ch] = factor;
+      if (factor == 0)
+        fLog->Entry(MongoLog::Warning, "Channel %i above %.1f MB/s for %i updates (%.1f MB/s), masking it",
+            ch, fLimit/1e6, fHoldoff, rate/1e6);
+      else
+        fLog->Entry(MongoLog::Warning, "Channel %i above %.1f MB/s for %i updates (%.1f MB/s), prescaling by %i",
+            ch, fLimit/1e6, fHoldoff, rate/1e6, factor);
+    } else {
+      if (rate >= fRestore) {
+        fCool.erase(ch);
+        continue;
+      }
+      if (++fCool[ch] < fHoldoff) continue;
+      fCool.erase(ch);
+      fFactor[ch] = configured;
+      fLog->Entry(MongoLog::Message, "Channel %i back below %.1f MB/s (%.1f MB/s), prescale restored to %i",
+          ch, fRestore/1e6, rate/1e6, configured);
+    }
+  }
+}
+
+std::map<int, int> ChannelPrescaler::Prescaled() {
+  std::map<int, int> ret;
+  for (int ch = 0; ch < kMaxChannels; ch++)
+    if (int f = fFactor[ch]; f != 1) ret[ch] = f;
+  return ret;
+}
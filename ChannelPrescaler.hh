@@ -0,0 +1,50 @@
+#ifndef _CHANNELPRESCALER_HH_
+#define _CHANNELPRESCALER_HH_
+
+#include <cstdint>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+class Options;
+class MongoLog;
+
+class ChannelPrescaler{
+  /*
+    Per-channel prescale factors, shared by all formatters. 1 keeps every
+    pulse of a channel, N keeps one in N, and 0 drops the channel entirely.
+    Factors start at the values in channel_prescale, and the hot-channel
+    guard raises them for channels whose rate stays above a limit, and puts
+    them back once the rate has come down again. The formatters drop the
+    pulses before doing anything else with them, so a hot channel costs very
+    little processing time. Rates are measured before the prescale, so the
+    guard sees what the channel is really doing even while it's throttled.
+  */
+
+public:
+  ChannelPrescaler(std::shared_ptr<Options>&, std::shared_ptr<MongoLog>&);
+  ~ChannelPrescaler();
+
+  int Factor(int16_t channel) {
+    return channel >= 0 && channel < kMaxChannels ? fFactor[channel].load(std::memory_order_relaxed) : 1;
+  }
+  // Only from the status thread: bytes from each channel since the last call
+  void Update(const std::map<int, int>& bytes_per_channel);
+  // Only from the status thread: {channel: factor} for everything not at 1
+  std::map<int, int> Prescaled();
+
+  static const int kMaxChannels = 4096;
+
+private:
+  std::unique_ptr<std::atomic_int[]> fFactor;
+  std::map<int, int> fConfigured; // from the options
+  std::map<int, int> fHot, fCool; // consecutive updates above/below the limits
+  double fLimit, fRestore; // bytes/s
+  int fHoldoff, fGuardFactor;
+  std::string fGuardAction;
+  long fLastUpdate; // ns
+  std::shared_ptr<MongoLog> fLog;
+};
+
+#endif // _CHANNELPRESCALER_HH_ defined
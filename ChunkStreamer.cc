@@ -0,0 +1,153 @@
+#include "ChunkStreamer.hh"
+#include "MongoLog.hh"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+ChunkStreamer::ChunkStreamer(const std::string& path, int timeout_ms,
+    std::shared_ptr<MongoLog>& log) {
+  fPath = path;
+  fTimeout = timeout_ms;
+  fLog = log;
+  fClientFD = -1;
+  fCredits = 0;
+  fCreditWord = 0;
+  fCreditBytes = 0;
+  fChunksStreamed = fChunksRefused = 0;
+
+  struct sockaddr_un addr;
+  if (fPath.size() >= sizeof(addr.sun_path))
+    throw std::runtime_error("Socket path too long: " + fPath);
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, fPath.c_str(), sizeof(addr.sun_path)-1);
+  unlink(fPath.c_str());
+  if ((fListenFD = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    throw std::runtime_error("Can't open socket");
+  if (bind(fListenFD, (struct sockaddr*)&addr, sizeof(addr)) || listen(fListenFD, 1)) {
+    close(fListenFD);
+    throw std::runtime_error("Can't bind socket to " + fPath + ": " + std::strerror(errno));
+  }
+  fRun = true;
+  fListenThread = std::thread(&ChunkStreamer::Listen, this);
+}
+
+ChunkStreamer::~ChunkStreamer() {
+  fRun = false;
+  if (fListenThread.joinable()) fListenThread.join();
+  DropClient();
+  close(fListenFD);
+  unlink(fPath.c_str());
+  fLog->Entry(MongoLog::Local, "Streamed %li chunks, %li went to disk instead",
+      fChunksStreamed.load(), fChunksRefused.load());
+}
+
+void ChunkStreamer::Listen() {
+  // this func runs in its own thread. It accepts consumers and collects
+  // credits. Never blocks on the consumer, so the destructor can't get stuck
+  // behind one that sent half a credit word and stopped
+  struct pollfd fds[2];
+  ssize_t ret;
+  while (fRun == true) {
+    fds[0] = {fListenFD, POLLIN, 0};
+    fds[1] = {fClientFD, POLLIN, 0}; // negative fd is ignored
+    if (poll(fds, 2, 100) <= 0) continue;
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(fListenFD, nullptr, nullptr);
+      if (fd < 0) continue;
+      if (fClientFD >= 0) {
+        fLog->Entry(MongoLog::Local, "Already have a stream consumer, rejecting another");
+        close(fd);
+      } else {
+        fLog->Entry(MongoLog::Local, "Stream consumer connected on %s", fPath.c_str());
+        int bufsize = 4<<20; // fewer trips through poll in SendAll
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+        fCreditBytes = 0;
+        fClientFD = fd;
+      }
+    }
+    if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+      ret = recv(fClientFD, (char*)&fCreditWord + fCreditBytes, sizeof(fCreditWord) - fCreditBytes,
+          MSG_DONTWAIT);
+      if (ret > 0) {
+        fCreditBytes += ret;
+        if (fCreditBytes == sizeof(fCreditWord)) {
+          // others only ever take credits, so this can't go over the limit
+          long grant = std::min<long>(fCreditWord, kMaxCredits - fCredits);
+          if (grant > 0) fCredits += grant;
+          fCreditBytes = 0;
+        }
+      } else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        continue;
+      } else {
+        fLog->Entry(MongoLog::Local, "Stream consumer went away");
+        const std::lock_guard<std::mutex> lk(fSendMutex);
+        DropClient();
+      }
+    }
+  }
+}
+
+void ChunkStreamer::DropClient() {
+  int fd = fClientFD.exchange(-1);
+  if (fd >= 0) close(fd);
+  fCredits = 0;
+}
+
+int ChunkStreamer::SendAll(const char* data, size_t bytes, bool first) {
+  // returns 1 if nothing was sent because the socket is full (so the caller
+  // can still back out), otherwise 0 for success and -1 for failure
+  size_t sent = 0;
+  ssize_t ret;
+  struct pollfd pfd = {fClientFD, POLLOUT, 0};
+  while (sent < bytes) {
+    ret = send(fClientFD, data + sent, bytes - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (ret > 0) {
+      sent += ret;
+      first = false;
+    } else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (first) return 1;
+      // we're mid-frame so we have to finish it, but only wait so long
+      if (poll(&pfd, 1, fTimeout) <= 0) return -1;
+    } else if (ret < 0 && errno == EINTR) {
+      continue;
+    } else {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+bool ChunkStreamer::Send(const std::string& name, const std::string& host,
+    const char* data, uint32_t bytes, uint32_t uncompressed) {
+  // Never wait on another formatter, just use the disk this time
+  std::unique_lock<std::mutex> lk(fSendMutex, std::try_to_lock);
+  if (!lk.owns_lock() || fClientFD < 0 || fCredits <= 0) {
+    fChunksRefused++;
+    return false;
+  }
+  frame_header_t header{kMagic, kVersion, uint32_t(name.size()), uint32_t(host.size()),
+    bytes, uncompressed};
+  int ret = SendAll((const char*)&header, sizeof(header), true);
+  if (ret == 0) ret = SendAll(name.data(), name.size(), false);
+  if (ret == 0) ret = SendAll(host.data(), host.size(), false);
+  if (ret == 0) ret = SendAll(data, bytes, false);
+  if (ret == 1) {
+    fChunksRefused++;
+    return false;
+  } else if (ret == -1) {
+    // consumer can't see where the next frame starts any more
+    fLog->Entry(MongoLog::Warning, "Stream consumer stalled mid-chunk, disconnecting it");
+    DropClient();
+    fChunksRefused++;
+    return false;
+  }
+  fCredits--;
+  fChunksStreamed++;
+  return true;
+}
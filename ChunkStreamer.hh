@@ -0,0 +1,67 @@
+#ifndef _CHUNKSTREAMER_HH_
+#define _CHUNKSTREAMER_HH_
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+
+class MongoLog;
+
+class ChunkStreamer{
+  /*
+    Hands finished chunks to one local consumer over a unix socket instead of
+    writing them to disk. The consumer hands out credits (one credit = one
+    chunk it's ready to read right away); without credits, or if the socket is
+    backed up, Send returns false and the formatter writes the chunk to disk
+    like usual. A consumer that takes credits and then stops reading gets
+    disconnected, since the formatters won't wait for it.
+
+    Consumer -> redax: uint32_t credits, any time (at most kMaxCredits are
+    kept, the rest are ignored)
+    redax -> consumer: frame_header_t, chunk name, host name, payload
+  */
+
+public:
+  ChunkStreamer(const std::string& path, int timeout_ms, std::shared_ptr<MongoLog>&);
+  ~ChunkStreamer();
+
+  bool Send(const std::string& name, const std::string& host, const char* data,
+      uint32_t bytes, uint32_t uncompressed);
+  long ChunksStreamed() {return fChunksStreamed;}
+  long ChunksRefused() {return fChunksRefused;}
+
+  struct frame_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t name_length;
+    uint32_t host_length;
+    uint64_t bytes;
+    uint64_t uncompressed_bytes;
+  };
+  static const uint32_t kMagic = 0x52445853; // "RDXS"
+  static const uint32_t kVersion = 1;
+  static const long kMaxCredits = 1<<20;
+
+private:
+  void Listen();
+  void DropClient();
+  int SendAll(const char*, size_t, bool);
+
+  std::string fPath;
+  int fTimeout;
+  int fListenFD;
+  std::atomic_int fClientFD;
+  std::atomic_long fCredits;
+  uint32_t fCreditWord; // what's arrived so far of the next one, listener thread only
+  size_t fCreditBytes;
+  std::atomic_bool fRun;
+  std::atomic_long fChunksStreamed, fChunksRefused;
+  std::mutex fSendMutex;
+  std::thread fListenThread;
+  std::shared_ptr<MongoLog> fLog;
+};
+
+#endif // _CHUNKSTREAMER_HH_ defined
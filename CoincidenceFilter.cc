@@ -0,0 +1,176 @@
+#include "CoincidenceFilter.hh"
+#include "MongoLog.hh"
+#include "Options.hh"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <stdexcept>
+
+CoincidenceFilter::CoincidenceFilter(std::shared_ptr<Options>& opts, std::shared_ptr<MongoLog>& log,
+    int formatters, int64_t chunk_length) {
+  fLog = log;
+  fChunkLength = chunk_length;
+  fWindow = opts->GetInt("coincidence_window_ns", 150);
+  fMinChannels = opts->GetInt("coincidence_min_channels", 3);
+  fMinArea = opts->GetDouble("coincidence_min_area", 0);
+  fPrescale = std::max(0, opts->GetInt("coincidence_prescale", 100));
+  fTimeout = opts->GetInt("coincidence_timeout_ms", 2000);
+  fLatest.reserve(formatters);
+  fFormatters = formatters;
+  fLastActive = std::make_unique<std::atomic_long[]>(formatters);
+  for (int i = 0; i < formatters; i++) fLastActive[i] = 0;
+  fTimeouts = fTimeoutsLogged = 0;
+  fForgotten = -1;
+  fPulsesSeen = fPulsesKept = fClustersSeen = fClustersKept = 0;
+  if (fWindow <= 0 || fMinChannels <= 0)
+    throw std::runtime_error("Invalid coincidence settings");
+}
+
+CoincidenceFilter::~CoincidenceFilter() {
+  fChunks.clear();
+}
+
+int CoincidenceFilter::Register() {
+  const std::lock_guard<std::mutex> lk(fMutex);
+  if ((int)fLatest.size() >= fFormatters)
+    throw std::runtime_error("More formatters than the coincidence filter was made for");
+  fLatest.push_back(-1);
+  return fLatest.size()-1;
+}
+
+void CoincidenceFilter::Active(int id) {
+  fLastActive[id] = std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+void CoincidenceFilter::Finish(int id) {
+  {
+    const std::lock_guard<std::mutex> lk(fMutex);
+    fLatest[id] = INT_MAX;
+  }
+  fCV.notify_all();
+}
+
+bool CoincidenceFilter::Complete(int chunk) {
+  // formatters write their chunks in order, so one that has handed in a later
+  // chunk has nothing more for this one. One that's idle (or never had any
+  // data) won't hand anything in until more data shows up, so it's no use
+  // waiting for it either
+  long idle = std::chrono::steady_clock::now().time_since_epoch().count() - kIdleNs;
+  for (size_t i = 0; i < fLatest.size(); i++)
+    if (fLatest[i] < chunk && fLastActive[i] > idle) return false;
+  return true;
+}
+
+CoincidenceFilter::intervals_t CoincidenceFilter::Decide(int id, int chunk,
+    std::vector<pulse_t>&& pulses) {
+  std::unique_lock<std::mutex> lk(fMutex);
+  fPulsesSeen += pulses.size();
+  if (chunk <= fForgotten) {
+    // late data for a chunk everyone else is done with. Nothing to compare it
+    // to any more, so it all goes through
+    return {{INT64_MIN, INT64_MAX}};
+  }
+  // shared so it can't disappear from under us while we wait
+  auto& entry = fChunks[chunk];
+  if (!entry) entry = std::make_shared<chunk_t>();
+  std::shared_ptr<chunk_t> c = entry;
+  if (c->decided) {
+    // arrived after the others were done with it, it is what it is
+    return c->passed;
+  }
+  c->pulses.insert(c->pulses.end(), pulses.begin(), pulses.end());
+  fLatest[id] = std::max(fLatest[id], chunk);
+  fCV.notify_all();
+  // formatters going idle don't tell anyone, so check again every so often
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(fTimeout);
+  while (!c->decided && !Complete(chunk)) {
+    auto now = std::chrono::steady_clock::now();
+    if (now < deadline) {
+      fCV.wait_until(lk, std::min(deadline, now + std::chrono::nanoseconds(kIdleNs)));
+      continue;
+    }
+    // somebody's stuck. Go with what's here rather than hold up writing, but
+    // without caching it so latecomers still count
+    fTimeouts++;
+    if (now - fLastTimeoutLog > std::chrono::seconds(10)) {
+      fLog->Entry(MongoLog::Local, "Coincidence filter timed out on chunk %i (%li times since the last message)",
+          chunk, fTimeouts - fTimeoutsLogged);
+      fTimeoutsLogged = fTimeouts;
+      fLastTimeoutLog = now;
+    }
+    std::vector<pulse_t> so_far(c->pulses);
+    return Cluster(so_far, false);
+  }
+  if (!c->decided) {
+    c->passed = Cluster(c->pulses, true);
+    c->decided = true;
+    c->pulses.clear();
+    c->pulses.shrink_to_fit();
+  }
+  intervals_t ret = c->passed;
+  // forget what everybody has moved well past
+  int oldest = *std::min_element(fLatest.begin(), fLatest.end()) - 2;
+  for (auto it = fChunks.begin(); it != fChunks.end() && it->first <= oldest; )
+    it = fChunks.erase(it);
+  fForgotten = std::max(fForgotten, oldest);
+  return ret;
+}
+
+CoincidenceFilter::intervals_t CoincidenceFilter::Cluster(std::vector<pulse_t>& pulses, bool count) {
+  // Pulses join a cluster while each starts within the window of the one before
+  intervals_t ret;
+  std::sort(pulses.begin(), pulses.end(), [](auto& l, auto& r) {return l.start < r.start;});
+  std::vector<int16_t> channels;
+  long clusters(0), passed(0);
+  for (size_t i = 0; i < pulses.size(); ) {
+    int64_t start = pulses[i].start, end = pulses[i].end, last = start;
+    double area = 0;
+    channels.clear();
+    for (; i < pulses.size() && pulses[i].start - last <= fWindow; i++) {
+      last = pulses[i].start;
+      end = std::max(end, pulses[i].end);
+      area += pulses[i].area;
+      channels.push_back(pulses[i].channel);
+    }
+    std::sort(channels.begin(), channels.end());
+    int n_channels = std::unique(channels.begin(), channels.end()) - channels.begin();
+    clusters++;
+    if (n_channels >= fMinChannels || (fMinArea > 0 && area >= fMinArea)) {
+      passed++;
+      if (ret.size() > 0 && start <= ret.back().second)
+        ret.back().second = std::max(ret.back().second, end);
+      else
+        ret.emplace_back(start, end);
+    }
+  }
+  if (count) {
+    fClustersSeen += clusters;
+    fClustersKept += passed;
+  }
+  return ret;
+}
+
+bool CoincidenceFilter::Keep(const intervals_t& passed, int chunk, int64_t start, int64_t end,
+    int16_t channel) {
+  bool keep = false;
+  if (start < chunk*fChunkLength + fWindow || end > (chunk+1)*fChunkLength - fWindow) {
+    // the rest of its cluster could be in the chunk next door
+    keep = true;
+  } else {
+    // the first cluster starting after this pulse ends, and the one before it
+    auto it = std::upper_bound(passed.begin(), passed.end(), end,
+        [](int64_t t, auto& p) {return t < p.first;});
+    keep = it != passed.begin() && std::prev(it)->second >= start;
+  }
+  if (!keep && fPrescale > 0) {
+    // hash rather than count, so which ones we keep doesn't depend on which
+    // thread saw what, or in which order
+    uint64_t h = uint64_t(start) ^ (uint64_t(uint16_t(channel)) << 48);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    keep = h % fPrescale == 0;
+  }
+  if (keep) fPulsesKept++;
+  return keep;
+}
@@ -0,0 +1,90 @@
+#ifndef _COINCIDENCEFILTER_HH_
+#define _COINCIDENCEFILTER_HH_
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <condition_variable>
+#include <chrono>
+
+class Options;
+class MongoLog;
+
+class CoincidenceFilter{
+  /*
+    Software coincidence trigger shared by all the formatters of this host.
+    When a formatter is about to write a chunk it hands in a summary of every
+    pulse it has for that chunk, and waits until the other formatters have
+    done the same (or have moved past that chunk). The pulses of all of them
+    are then clustered in time, and clusters with enough channels or enough
+    area pass. Formatters only write the pulses that overlap a passing
+    cluster, plus a prescaled sample of the rest and anything close enough
+    to a chunk boundary that its partners could be in the next chunk.
+    Formatters that haven't had any data for a while aren't waited for,
+    they won't write anything until they get some.
+  */
+
+public:
+  CoincidenceFilter(std::shared_ptr<Options>&, std::shared_ptr<MongoLog>&, int formatters,
+      int64_t chunk_length);
+  ~CoincidenceFilter();
+
+  struct pulse_t {
+    int64_t start, end; // ns
+    float area;
+    int16_t channel;
+  };
+  typedef std::vector<std::pair<int64_t, int64_t>> intervals_t;
+
+  // Each formatter gets a number, which it then uses to hand in its pulses
+  int Register();
+  // Hands in one formatter's pulses for a chunk, returns the time ranges of the
+  // clusters that passed (sorted, not overlapping)
+  intervals_t Decide(int id, int chunk, std::vector<pulse_t>&& pulses);
+  // Whether a formatter should write this pulse
+  bool Keep(const intervals_t& passed, int chunk, int64_t start, int64_t end, int16_t channel);
+  // This formatter won't hand anything else in, so don't wait for it
+  void Finish(int id);
+  // This formatter is working on data (call for each packet, it's cheap)
+  void Active(int id);
+
+  long PulsesSeen() {return fPulsesSeen;}
+  long PulsesKept() {return fPulsesKept;}
+  long ClustersSeen() {return fClustersSeen;}
+  long ClustersKept() {return fClustersKept;}
+  long Timeouts() {return fTimeouts;}
+
+private:
+  intervals_t Cluster(std::vector<pulse_t>&, bool);
+  bool Complete(int);
+
+  struct chunk_t {
+    chunk_t() : decided(false) {}
+    std::vector<pulse_t> pulses;
+    bool decided;
+    intervals_t passed;
+  };
+
+  std::map<int, std::shared_ptr<chunk_t>> fChunks;
+  std::vector<int> fLatest; // latest chunk from each formatter
+  int fFormatters;
+  std::unique_ptr<std::atomic_long[]> fLastActive; // steady_clock ns, 0 for never
+  static const long kIdleNs = 250'000'000; // no data this long and it's not worth waiting for
+  int fForgotten; // chunks up to here are done with
+  std::mutex fMutex;
+  std::condition_variable fCV;
+
+  int64_t fChunkLength, fWindow;
+  int fMinChannels, fPrescale, fTimeout;
+  double fMinArea;
+  std::atomic_long fPulsesSeen, fPulsesKept, fClustersSeen, fClustersKept;
+  long fTimeouts, fTimeoutsLogged;
+  std::chrono::steady_clock::time_point fLastTimeoutLog;
+  std::shared_ptr<MongoLog> fLog;
+};
+
+#endif // _COINCIDENCEFILTER_HH_ defined
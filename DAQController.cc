@@ -7,14 +7,27 @@
 #include "Options.hh"
 #include "StraxFormatter.hh"
 #include "MongoLog.hh"
+#include "LiveDataRing.hh"
+#include "ChunkStreamer.hh"
+#include "CoincidenceFilter.hh"
+#include "ChannelPrescaler.hh"
+#include "MetricsRegistry.hh"
+#include "CBLTChain.hh"
+#include "ReadScheduler.hh"
+#include "RawCapture.hh"
 #include <algorithm>
 #include <bitset>
 #include <chrono>
 #include <cmath>
 #include <numeric>
+#include <iomanip>
 
 #include <bsoncxx/builder/stream/document.hpp>
 
+#ifndef REDAX_VERSION
+#define REDAX_VERSION "unknown"
+#endif
+
 // Status:
 // 0-idle
 // 1-arming
@@ -106,7 +119,25 @@ int DAQController::Arm(std::shared_ptr<Options>& options){
 	digi->AcquisitionStop();
     }
   }
+  fChains.clear();
+  if (fOptions->GetInt("cblt", 0) == 1) {
+    // one chain per crate, in the order the boards are in the options
+    std::map<std::pair<int, int>, std::vector<std::shared_ptr<V1724>>> crates;
+    for (auto d : fOptions->GetBoards("V17XX"))
+      for (auto& digi : fDigitizers[d.link])
+        if (digi->bid() == d.board) crates[{d.link, d.crate}].push_back(digi);
+    for (auto& c : crates) {
+      try {
+        fChains[c.first.first].emplace_back(std::make_unique<CBLTChain>(c.second, fOptions,
+              fLog, c.first.first, c.first.second));
+      } catch (const std::exception& e) {
+        fLog->Entry(MongoLog::Warning, "No CBLT for link %i crate %i, reading its boards one at a time: %s",
+            c.first.first, c.first.second, e.what());
+      }
+    }
+  }
   fCounter = 0;
+  fSplitPackets = 0;
   if (OpenThreads()) {
     fLog->Entry(MongoLog::Warning, "Error opening threads");
     fStatus = DAXHelpers::Idle;
@@ -142,6 +173,7 @@ int DAQController::Start(){
       }
     }
   }
+  fRunStart = std::chrono::steady_clock::now();
   fStatus = DAXHelpers::Running;
   return 0;
 }
@@ -173,6 +205,7 @@ int DAQController::Stop(){
   fLog->Entry(MongoLog::Debug, "Stopped digitizers, closing threads");
   CloseThreads();
   fLog->Entry(MongoLog::Local, "Closing Digitizers");
+  fChains.clear();
   for(auto& link : fDigitizers ){
     for(auto& digi : link.second){
       digi->End();
@@ -198,13 +231,19 @@ void DAQController::ReadData(int link){
   uint32_t board_status = 0;
   int readcycler = 0;
   int err_val = 0;
-  std::list<std::unique_ptr<data_packet>> local_buffer;
+  std::vector<readout_t> reads;
   std::unique_ptr<data_packet> dp;
   int words = 0;
-  int local_size(0);
   fRunning[link] = true;
   std::chrono::microseconds sleep_time(fOptions->GetInt("us_between_reads", 10));
+  // with readout_async all we do here is transfer, the rest happens in ProcessLink
+  link_queue_t* queue = fLinkQueues.count(link) ? fLinkQueues.at(link).get() : nullptr;
+  std::atomic_long& link_busy = fLinkBusy.at(link);
+  ReadScheduler* scheduler = fSchedulers.at(link).get();
+  RawCapture* capture = fCaptures.count(link) ? fCaptures.at(link).get() : nullptr;
+  std::list<std::unique_ptr<data_packet>> chain_buffer;
   while(fReadLoop){
+    long busy = 0;
     for(auto& digi : fDigitizers[link]) {
 
       // Every 1k reads check board status
@@ -227,35 +266,201 @@ void DAQController::ReadData(int link){
                                          digi->bid());
         }
       }
-      if((words = digi->Read(dp))<0){
+    } // for digi in digitizers
+    // as many reads as there are boards not in a chain, but in the order the
+    // scheduler likes, which might read some more than once
+    for (unsigned i = 0; i < scheduler->GetNumBoards(); i++) {
+      auto& digi = scheduler->Next();
+      auto start = std::chrono::steady_clock::now();
+      words = digi->Read(dp);
+      auto end = std::chrono::steady_clock::now();
+      busy += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+      scheduler->Done(std::max(words, 0)*sizeof(char32_t));
+      if(words<0){
         dp.reset();
         fStatus = DAXHelpers::Error;
         break;
       } else if(words>0){
         dp->digi = digi;
-        local_buffer.emplace_back(std::move(dp));
-        local_size += words*sizeof(char32_t);
+        reads.emplace_back(std::move(dp), end);
       }
-    } // for digi in digitizers
-    if (local_buffer.size() > 0) {
-      fDataRate += local_size;
-      int selector = (fCounter++)%fNProcessingThreads;
-      fFormatters[selector]->ReceiveDatapackets(local_buffer, local_size);
-      local_size = 0;
+    }
+    for (auto& chain : fChains[link]) {
+      auto start = std::chrono::steady_clock::now();
+      words = chain->Read(chain_buffer);
+      auto end = std::chrono::steady_clock::now();
+      busy += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+      if (words < 0) {
+        chain_buffer.clear();
+        fStatus = DAXHelpers::Error;
+        break;
+      }
+      for (auto& cdp : chain_buffer) reads.emplace_back(std::move(cdp), end);
+      chain_buffer.clear();
+    }
+    link_busy += busy;
+    if (reads.size() > 0) {
+      if (queue == nullptr) {
+        Dispatch(reads, capture);
+      } else {
+        std::unique_lock<std::mutex> lk(queue->mutex);
+        if (queue->reads.size() >= fReadoutBuffers) {
+          // the other side can't keep up, so the link waits
+          fLinkStalls.at(link)++;
+          queue->cv.wait(lk, [&]{return queue->reads.size() < fReadoutBuffers;});
+        }
+        queue->reads.emplace_back(std::move(reads));
+        lk.unlock();
+        queue->cv.notify_all();
+      }
+      reads.clear();
     }
     readcycler++;
     std::this_thread::sleep_for(sleep_time);
   } // while run
+  if (queue != nullptr) {
+    {
+      const std::lock_guard<std::mutex> lg(queue->mutex);
+      queue->done = true;
+    }
+    queue->cv.notify_all();
+  }
   fRunning[link] = false;
   fLog->Entry(MongoLog::Local, "RO thread %i returning", link);
 }
 
+void DAQController::ProcessLink(int link) {
+  // The other half of readout_async: takes what ReadData transferred, in the
+  // order it was read, while the next transfers are already going
+  link_queue_t& queue = *fLinkQueues.at(link);
+  RawCapture* capture = fCaptures.count(link) ? fCaptures.at(link).get() : nullptr;
+  std::vector<readout_t> reads;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lk(queue.mutex);
+      queue.cv.wait(lk, [&]{return queue.reads.size() > 0 || queue.done;});
+      if (queue.reads.empty()) break;
+      reads = std::move(queue.reads.front());
+      queue.reads.pop_front();
+    }
+    queue.cv.notify_all();
+    Dispatch(reads, capture);
+    reads.clear();
+  }
+  fLog->Entry(MongoLog::Local, "Link %i processing thread returning", link);
+}
+
+void DAQController::Dispatch(std::vector<readout_t>& reads, RawCapture* capture) {
+  // Indexes the events and hands everything to one formatter, except
+  // packets too big for one formatter to get through on its own. The raw
+  // capture gets them whole, once the first event's time is known. A board
+  // can be read more than once per pass, so whatever was collected goes out
+  // before a packet gets split, or a formatter could get a board's newer
+  // data ahead of its older
+  std::list<std::unique_ptr<data_packet>> local_buffer;
+  int local_size = 0;
+  auto send = [&]{
+    if (local_buffer.empty()) return;
+    fDataRate += local_size;
+    int selector = (fCounter++)%fNProcessingThreads;
+    fFormatters[selector]->ReceiveDatapackets(local_buffer, local_size);
+    local_buffer.clear();
+    local_size = 0;
+  };
+  for (auto& [dp, read_time] : reads) {
+    dp->digi->IndexEvents(dp, read_time);
+    if (capture != nullptr) capture->Add(*dp, read_time);
+    int bytes = dp->buff.size()*sizeof(char32_t);
+    if (fSplitWords > 0 && dp->buff.size() > fSplitWords && dp->events.size() > 1) {
+      send();
+      fDataRate += bytes;
+      SplitPacket(dp);
+    } else {
+      local_buffer.emplace_back(std::move(dp));
+      local_size += bytes;
+    }
+  }
+  send();
+}
+
+void DAQController::SplitPacket(std::unique_ptr<data_packet>& dp) {
+  // Cuts the packet into about equal pieces at the first event past each
+  // even share, one per formatter at most. The pieces share the buffer and
+  // take their part of the event index along, times included, so it doesn't
+  // matter which gets processed first. The board's deadtime goes with the
+  // first piece, it only has to get written once
+  size_t n = dp->buff.size();
+  size_t pieces = std::min<size_t>(fNProcessingThreads, dp->events.size());
+  std::vector<size_t> cuts{0}; // in events
+  for (size_t i = 1; i < pieces; i++) {
+    size_t e = std::lower_bound(dp->events.begin() + cuts.back(), dp->events.end(),
+        i*n/pieces) - dp->events.begin();
+    if (e == dp->events.size()) break;
+    if (e > cuts.back()) cuts.push_back(e);
+  }
+  cuts.push_back(dp->events.size());
+  for (size_t i = 0; i+1 < cuts.size(); i++) {
+    size_t start = i == 0 ? 0 : dp->events[cuts[i]];
+    size_t end = cuts[i+1] == dp->events.size() ? n : dp->events[cuts[i+1]];
+    auto piece = std::make_unique<data_packet>(dp->storage, dp->buff.substr(start, end-start));
+    piece->digi = dp->digi;
+    for (size_t e = cuts[i]; e < cuts[i+1]; e++) piece->events.push_back(dp->events[e] - start);
+    piece->times.assign(dp->times.begin() + cuts[i], dp->times.begin() + cuts[i+1]);
+    if (i == 0) piece->deadtime = std::move(dp->deadtime);
+    std::list<std::unique_ptr<data_packet>> out;
+    out.emplace_back(std::move(piece));
+    int selector = (fCounter++)%fNProcessingThreads;
+    fFormatters[selector]->ReceiveDatapackets(out, (end-start)*sizeof(char32_t));
+  }
+  if (cuts.size() > 2) fSplitPackets++;
+  dp.reset();
+}
+
 int DAQController::OpenThreads(){
   const std::lock_guard<std::mutex> lg(fMutex);
+  if (int ring_mb = fOptions->GetInt("live_ring_mb", 0); ring_mb > 0) {
+    std::string ring_name = fOptions->GetString("live_ring_name", "/redax_live_" + fHostname);
+    try {
+      fLiveRing = std::make_shared<LiveDataRing>(ring_name, long(ring_mb)<<20);
+      fLog->Entry(MongoLog::Local, "Live data ring %s with %i MB", ring_name.c_str(), ring_mb);
+    } catch(const std::exception& e) {
+      // the ring is a nice-to-have, not worth failing the arm over
+      fLog->Entry(MongoLog::Warning, "Couldn't open live data ring: %s", e.what());
+      fLiveRing.reset();
+    }
+  }
+  if (std::string sock = fOptions->GetString("stream_socket_path", ""); sock != "") {
+    try {
+      fStreamer = std::make_shared<ChunkStreamer>(sock,
+          fOptions->GetInt("stream_send_timeout_ms", 100), fLog);
+      fLog->Entry(MongoLog::Local, "Streaming chunks on %s", sock.c_str());
+    } catch(const std::exception& e) {
+      fLog->Entry(MongoLog::Warning, "Couldn't open chunk stream: %s", e.what());
+      fStreamer.reset();
+    }
+  }
+  if (fOptions->GetInt("coincidence_filter", 0)) {
+    // unlike the others this changes what gets written, so it has to work
+    try {
+      int64_t chunk_length = int64_t((fOptions->GetDouble("strax_chunk_length", 5) +
+            fOptions->GetDouble("strax_chunk_overlap", 0.5))*1e9);
+      fCoincidence = std::make_shared<CoincidenceFilter>(fOptions, fLog, fNProcessingThreads,
+          chunk_length);
+    } catch(const std::exception& e) {
+      fLog->Entry(MongoLog::Warning, "Couldn't set up coincidence filter: %s", e.what());
+      return -1;
+    }
+  }
+  fPrescaler = std::make_shared<ChannelPrescaler>(fOptions, fLog);
+  fMetrics = std::make_shared<MetricsRegistry>(fOptions->GetInt("metrics_level", 1));
+  if (fMetrics->GetLevel() != fOptions->GetInt("metrics_level", 1))
+    fLog->Entry(MongoLog::Local, "Metrics level %i, this build only goes up to %i",
+        fMetrics->GetLevel(), REDAX_METRICS_LEVEL);
   fProcessingThreads.reserve(fNProcessingThreads);
   for(int i=0; i<fNProcessingThreads; i++){
     try {
-      fFormatters.emplace_back(std::make_unique<StraxFormatter>(fOptions, fLog));
+      fFormatters.emplace_back(std::make_unique<StraxFormatter>(fOptions, fLog, fLiveRing,
+            fStreamer, fCoincidence, fPrescaler, fMetrics));
       fProcessingThreads.emplace_back(&StraxFormatter::Process, fFormatters.back().get());
     } catch(const std::exception& e) {
       fLog->Entry(MongoLog::Warning, "Error opening processing threads: %s",
@@ -263,9 +468,56 @@ int DAQController::OpenThreads(){
       return -1;
     }
   }
-  fReadoutThreads.reserve(fDigitizers.size());
-  for (auto& p : fDigitizers)
+  fRunStart = fLastStatus = std::chrono::steady_clock::now();
+  fLastDeadtime.clear();
+  fSplitPackets = 0;
+  fSplitWords = std::max(0, fOptions->GetInt("packet_split_kb", 4096))*1024/sizeof(char32_t);
+  bool async = fOptions->GetInt("readout_async", 0) == 1;
+  fReadoutBuffers = std::max(2, fOptions->GetInt("readout_buffers", 4));
+  fLinkQueues.clear();
+  fLinkBusy.clear();
+  fLastLinkBusy.clear();
+  fLinkStalls.clear();
+  fSchedulers.clear();
+  for (auto& p : fDigitizers) {
+    // boards in a CBLT chain get read with the rest of the chain
+    std::vector<std::shared_ptr<V1724>> boards;
+    for (auto& digi : p.second)
+      if (std::none_of(fChains[p.first].begin(), fChains[p.first].end(), [&](auto& chain) {
+            auto& chained = chain->GetBoards();
+            return std::find(chained.begin(), chained.end(), digi) != chained.end();}))
+        boards.push_back(digi);
+    fSchedulers[p.first] = std::make_unique<ReadScheduler>(boards, fOptions);
+    fLinkBusy[p.first] = 0;
+    fLinkStalls[p.first] = 0;
+    if (async) fLinkQueues[p.first] = std::make_unique<link_queue_t>();
+  }
+  fCaptures.clear();
+  if (std::string path = fOptions->GetString("raw_capture_path", ""); path != "") {
+    // same run name as the strax output
+    int number = fOptions->GetInt("number", -1);
+    std::string run = number < 0 ? "run" : std::to_string(number);
+    if (number >= 0 && run.size() < 6) run.insert(0, 6 - run.size(), '0');
+    long max_bytes = std::max(1, fOptions->GetInt("raw_capture_buffer_mb", 256))*(1l<<20);
+    long block_bytes = std::max(1, fOptions->GetInt("raw_capture_block_mb", 16))*(1l<<20);
+    for (auto& p : fDigitizers) {
+      std::string filename = path + "/" + run + "_" + fHostname + "_link" +
+        std::to_string(p.first) + ".raw";
+      try {
+        fCaptures[p.first] = std::make_unique<RawCapture>(filename, p.first, max_bytes,
+            block_bytes, fLog);
+        fLog->Entry(MongoLog::Local, "Capturing link %i to %s", p.first, filename.c_str());
+      } catch(const std::exception& e) {
+        fLog->Entry(MongoLog::Warning, "Couldn't start raw capture: %s", e.what());
+        fCaptures.erase(p.first);
+      }
+    }
+  }
+  fReadoutThreads.reserve(fDigitizers.size()*(async ? 2 : 1));
+  for (auto& p : fDigitizers) {
     fReadoutThreads.emplace_back(&DAQController::ReadData, this, p.first);
+    if (async) fReadoutThreads.emplace_back(&DAQController::ProcessLink, this, p.first);
+  }
   return 0;
 }
 
@@ -282,9 +534,43 @@ void DAQController::CloseThreads(){
   }
   for (auto& t : fProcessingThreads) if (t.joinable()) t.join();
   fProcessingThreads.clear();
+  std::map<int, std::pair<long, long>> zle_stats;
+  for (auto& sf : fFormatters) sf->GetZLEStats(zle_stats);
   fLog->Entry(MongoLog::Local, "Destroying formatters");
   for (auto& sf : fFormatters) sf.reset();
   fFormatters.clear();
+  if (fLiveRing && fLiveRing->TooBig() > 0)
+    fLog->Entry(MongoLog::Warning, "%li records were too big for the live data ring, see live_ring_mb",
+        fLiveRing->TooBig());
+  fLiveRing.reset();
+  fStreamer.reset();
+  if (fPrescaler) {
+    if (auto prescaled = fPrescaler->Prescaled(); prescaled.size() > 0) {
+      std::stringstream msg;
+      msg << "Channels prescaled at the end of the run: ";
+      for (auto& [ch, factor] : prescaled) msg << ch << ":" << factor << " | ";
+      fLog->Entry(MongoLog::Local, msg.str());
+    }
+    fPrescaler.reset();
+  }
+  if (fMetrics && fOptions && fOptions->GetInt("performance_report", 1))
+    SaveReport(zle_stats, board_fails);
+  if (fMetrics && fMetrics->Counting()) {
+    fLog->Entry(MongoLog::Local, "Processed %li packets, %li events, %li fragments, "
+        "%li chunks (%.1f MB compressed to %.1f MB)",
+        fMetrics->Get(MetricsRegistry::kDataPackets), fMetrics->Get(MetricsRegistry::kEvents),
+        fMetrics->Get(MetricsRegistry::kFragments), fMetrics->Get(MetricsRegistry::kChunks),
+        fMetrics->Get(MetricsRegistry::kChunkBytes)/1e6,
+        fMetrics->Get(MetricsRegistry::kCompressedBytes)/1e6);
+  }
+  fMetrics.reset();
+  fCaptures.clear(); // writes out what's left
+  if (fCoincidence) {
+    fLog->Entry(MongoLog::Message, "Coincidence filter kept %li of %li pulses, %li of %li clusters passed, %li timeouts",
+        fCoincidence->PulsesKept(), fCoincidence->PulsesSeen(), fCoincidence->ClustersKept(),
+        fCoincidence->ClustersSeen(), fCoincidence->Timeouts());
+    fCoincidence.reset();
+  }
 
   if (std::accumulate(board_fails.begin(), board_fails.end(), 0,
 	[=](int tot, auto& iter) {return std::move(tot) + iter.second;})) {
@@ -293,22 +579,198 @@ void DAQController::CloseThreads(){
     for (auto& iter : board_fails) msg << iter.first << ":" << iter.second << " | ";
     fLog->Entry(MongoLog::Warning, msg.str());
   }
+  std::stringstream skipped;
+  for (auto& [link, digis] : fDigitizers)
+    for (auto& digi : digis)
+      if (long n = digi->GetSkippedWords(); n > 0) skipped << digi->bid() << ":" << n << " | ";
+  if (skipped.str().size() > 0)
+    fLog->Entry(MongoLog::Warning, "Words skipped to resync with the data: " + skipped.str());
+  std::stringstream missed;
+  for (auto& [link, digis] : fDigitizers)
+    for (auto& digi : digis)
+      if (long n = digi->GetMissedEvents(); n > 0)
+        missed << digi->bid() << ":" << n << "/" << n + digi->GetEventsRead() << " | ";
+  if (missed.str().size() > 0)
+    fLog->Entry(MongoLog::Warning, "Events lost between the boards and us: " + missed.str());
+  std::stringstream busy;
+  for (auto& [link, digis] : fDigitizers)
+    for (auto& digi : digis)
+      if (long n = digi->GetBusyIntervals(); n > 0)
+        busy << digi->bid() << ":" << n << "/" << digi->GetDeadtime()/1e6 << "ms | ";
+  if (busy.str().size() > 0)
+    fLog->Entry(MongoLog::Message, "Times boards were full / deadtime: " + busy.str());
+  if (zle_stats.size() > 0) {
+    long total_in(0), total_kept(0);
+    std::stringstream msg;
+    msg << std::fixed << std::setprecision(1);
+    for (auto& [ch, stats] : zle_stats) {
+      total_in += stats.first;
+      total_kept += stats.second;
+      msg << ch << ":" << (stats.second > 0 ? double(stats.first)/stats.second : 0.) << " | ";
+    }
+    fLog->Entry(MongoLog::Local, "Software ZLE reduction per channel: %s", msg.str().c_str());
+    fLog->Entry(MongoLog::Message, "Software ZLE kept %li of %li samples (reduction %.1f)",
+        total_kept, total_in, total_kept > 0 ? double(total_in)/total_kept : 0.);
+  }
+}
+
+void DAQController::SaveReport(const std::map<int, std::pair<long, long>>& zle_stats,
+    const std::map<int, int>& board_fails) {
+  // How this run went on this host, summed over all threads, so we can see
+  // from one software version to the next whether things got faster or slower
+  using namespace bsoncxx::builder::stream;
+  double seconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - fRunStart).count()/1e3;
+  long bytes = fMetrics->Get(MetricsRegistry::kBytesProcessed);
+  long chunk_bytes = fMetrics->Get(MetricsRegistry::kChunkBytes);
+  long compressed = fMetrics->Get(MetricsRegistry::kCompressedBytes);
+  auto report = document{};
+  report << "run" << fOptions->GetInt("number", -1) << "host" << fHostname <<
+    "time" << bsoncxx::types::b_date(std::chrono::system_clock::now()) <<
+    "version" << REDAX_VERSION << "mode" << fOptions->GetString("name", "none") <<
+    "metrics_level" << fMetrics->GetLevel() << "processing_threads" << fNProcessingThreads <<
+    "compressor" << fOptions->GetString("compressor", "lz4") <<
+    "compression_level" << fOptions->GetInt("compression_level", -1) <<
+    "prefilter" << fOptions->GetString("strax_prefilter", "none") <<
+    "seconds" << seconds << "split_packets" << int64_t(fSplitPackets);
+  if (fMetrics->Counting()) {
+    report << "mb_per_s" << (seconds > 0 ? bytes/seconds/1e6 : 0.) <<
+      "compression_ratio" << (compressed > 0 ? double(chunk_bytes)/compressed : 0.);
+    report << "counters" << open_document;
+    for (int c = 0; c < MetricsRegistry::kNumCounters; c++) {
+      auto counter = MetricsRegistry::Counter(c);
+      report << MetricsRegistry::Name(counter) << int64_t(fMetrics->Get(counter));
+    }
+    report << close_document;
+    // keyed by the lower edge of each log2 bucket
+    report << "histograms" << open_document;
+    for (int h = 0; h < MetricsRegistry::kNumHistograms; h++) {
+      auto hist = MetricsRegistry::Histogram(h);
+      report << MetricsRegistry::Name(hist) << open_document;
+      for (auto& [edge, n] : fMetrics->Get(hist)) report << std::to_string(edge) << int64_t(n);
+      report << close_document;
+    }
+    report << close_document;
+  }
+  if (fMetrics->Timing() && bytes > 0) {
+    // cpu time per MB of input, for each stage. ns per byte is ms per MB
+    const std::pair<MetricsRegistry::Counter, const char*> stages[] = {
+      {MetricsRegistry::kPacketTime, "data_packets"}, {MetricsRegistry::kEventTime, "events"},
+      {MetricsRegistry::kChannelTime, "channels"}, {MetricsRegistry::kChunkTime, "chunks"}};
+    report << "cpu_ms_per_mb" << open_document;
+    for (auto& [c, name] : stages) report << name << fMetrics->Get(c)/double(bytes);
+    report << close_document;
+  }
+  std::map<int, long> read_wait;
+  for (auto& [link, scheduler] : fSchedulers) scheduler->GetRunMaxWait(read_wait);
+  report << "boards" << open_document;
+  for (auto& [link, digis] : fDigitizers) {
+    for (auto& digi : digis) {
+      long reads(0), blts(0), saved(digi->GetBLTsSaved());
+      for (auto& [count, n] : digi->GetBLTCounter()) {
+        reads += n;
+        blts += count*n;
+      }
+      report << std::to_string(digi->bid()) << open_document << "link" << link <<
+        "bytes" << int64_t(digi->GetBytesRead()) << "reads" << int64_t(reads) <<
+        "blts" << int64_t(blts) << "blts_saved" << int64_t(saved) << "blt_size" << digi->GetBLTSize() <<
+        "mb_per_s" << (seconds > 0 ? digi->GetBytesRead()/seconds/1e6 : 0.) <<
+        "fails" << (board_fails.count(digi->bid()) ? board_fails.at(digi->bid()) : 0) <<
+        "skipped_words" << int64_t(digi->GetSkippedWords()) <<
+        "events" << int64_t(digi->GetEventsRead()) <<
+        "missed_events" << int64_t(digi->GetMissedEvents()) <<
+        "missed_bytes" << int64_t(digi->GetMissedBytes()) <<
+        "deadtime_ns" << int64_t(digi->GetDeadtime()) <<
+        "busy_intervals" << int64_t(digi->GetBusyIntervals()) <<
+        "max_read_wait_ms" << (read_wait.count(digi->bid()) ? read_wait[digi->bid()]/1e6 : 0.);
+      report << "blts_per_read" << open_document;
+      for (auto& [count, n] : digi->GetBLTCounter())
+        if (count > 0) report << std::to_string(count) << int64_t(n);
+      report << close_document;
+      report << close_document;
+    }
+  }
+  report << close_document;
+  // how much of the time each link was busy with transfers
+  report << "links" << open_document;
+  for (auto& [link, busy] : fLinkBusy)
+    report << std::to_string(link) << open_document <<
+      "utilization" << (seconds > 0 ? busy*1e-9/seconds : 0.) <<
+      "async" << (fLinkQueues.count(link) > 0) <<
+      "queue_full" << int64_t(fLinkStalls.at(link)) <<
+      "capture_dropped" << int64_t(fCaptures.count(link) ? fCaptures.at(link)->RecordsDropped() : 0) <<
+      close_document;
+  report << close_document;
+  if (zle_stats.size() > 0) {
+    // {samples in, samples kept}
+    report << "software_zle" << open_document;
+    for (auto& [ch, stats] : zle_stats)
+      report << std::to_string(ch) << open_array << int64_t(stats.first) <<
+        int64_t(stats.second) << close_array;
+    report << close_document;
+  }
+  fOptions->SaveBenchmarks(report << finalize);
+  fLog->Entry(MongoLog::Local, "Saved performance report");
 }
 
 void DAQController::StatusUpdate(mongocxx::collection* collection) {
   using namespace bsoncxx::builder::stream;
   auto insert_doc = document{};
-  std::map<int, int> retmap;
+  std::map<int, int> retmap, prescaled;
+  std::map<int, long> skipped;
+  std::map<int, std::pair<long, long>> missed;
+  std::map<int, double> deadtime;
+  std::map<int, int> blt_size;
+  std::map<int, double> link_util;
+  std::map<int, long> read_wait;
+  std::map<std::string, long> metrics;
   std::pair<long, long> buf{0,0};
   int rate = fDataRate;
   fDataRate = 0;
   {
     const std::lock_guard<std::mutex> lg(fMutex);
+    if (fMetrics) {
+      fMetrics->GetDataPerChan(retmap);
+      if (fMetrics->Counting()) {
+        for (int c = 0; c < MetricsRegistry::kNumCounters; c++) {
+          auto counter = MetricsRegistry::Counter(c);
+          if (long n = fMetrics->Get(counter); n > 0) metrics[MetricsRegistry::Name(counter)] = n;
+        }
+      }
+    }
+    // the digitizers don't go anywhere while there are formatters
+    if (fFormatters.size() > 0) {
+      auto now = std::chrono::steady_clock::now();
+      double seconds = std::chrono::duration<double>(now - fLastStatus).count();
+      fLastStatus = now;
+      for (auto& [link, digis] : fDigitizers)
+        for (auto& digi : digis) {
+          if (long n = digi->GetSkippedWords(); n > 0) skipped[digi->bid()] = n;
+          if (long n = digi->GetMissedEvents(); n > 0) missed[digi->bid()] = {n, digi->GetMissedBytes()};
+          blt_size[digi->bid()] = digi->GetBLTSize();
+          long dead = digi->GetDeadtime();
+          if (long& last = fLastDeadtime[digi->bid()]; dead > last && seconds > 0) {
+            deadtime[digi->bid()] = std::min(1., (dead - last)*1e-9/seconds);
+            last = dead;
+          }
+        }
+      for (auto& [link, scheduler] : fSchedulers) scheduler->GetMaxWait(read_wait);
+      for (auto& [link, busy] : fLinkBusy) {
+        long b = busy;
+        long& last = fLastLinkBusy[link];
+        if (seconds > 0) link_util[link] = std::min(1., (b - last)*1e-9/seconds);
+        last = b;
+      }
+    }
     for (auto& p : fFormatters) {
-      p->GetDataPerChan(retmap);
       auto x = p->GetBufferSize();
       buf.first += x.first;
       buf.second += x.second;
+      if (p->GetChunksLost() > 0) fStatus = DAXHelpers::Error; // data's going missing
+    }
+    if (fPrescaler) {
+      fPrescaler->Update(retmap);
+      prescaled = fPrescaler->Prescaled();
     }
   }
   auto doc = document{} <<
@@ -324,6 +786,46 @@ void DAQController::StatusUpdate(mongocxx::collection* collection) {
       for( auto const& pair : retmap)
         doc << std::to_string(pair.first) << short(pair.second>>10); // KB not MB
       } << close_document << 
+    "prescale" << open_document <<
+      [&](key_context<> doc){
+      for (auto const& [ch, factor] : prescaled)
+        doc << std::to_string(ch) << factor;
+      } << close_document <<
+    "skipped_words" << open_document <<
+      [&](key_context<> doc){
+      for (auto const& [bid, n] : skipped)
+        doc << std::to_string(bid) << int64_t(n);
+      } << close_document <<
+    "blt_size" << open_document <<
+      [&](key_context<> doc){
+      for (auto const& [bid, size] : blt_size)
+        doc << std::to_string(bid) << size;
+      } << close_document <<
+    "deadtime" << open_document <<
+      [&](key_context<> doc){
+      for (auto const& [bid, fraction] : deadtime)
+        doc << std::to_string(bid) << fraction;
+      } << close_document <<
+    "link_util" << open_document <<
+      [&](key_context<> doc){
+      for (auto const& [link, fraction] : link_util)
+        doc << std::to_string(link) << fraction;
+      } << close_document <<
+    "read_wait_ms" << open_document <<
+      [&](key_context<> doc){
+      for (auto const& [bid, wait] : read_wait)
+        doc << std::to_string(bid) << wait/1e6;
+      } << close_document <<
+    "missed_events" << open_document <<
+      [&](key_context<> doc){
+      for (auto const& [bid, n] : missed)
+        doc << std::to_string(bid) << open_array << int64_t(n.first) << int64_t(n.second) << close_array;
+      } << close_document <<
+    "metrics" << open_document <<
+      [&](key_context<> doc){
+      for (auto const& [name, n] : metrics)
+        doc << name << int64_t(n);
+      } << close_document <<
     finalize;
   collection->insert_one(std::move(doc)); // opts is const&
   return;
@@ -552,7 +1054,7 @@ int DAQController::FitBaselines(std::vector<std::shared_ptr<V1724>> &digis,
               if (!(channel_mask & (1 << ch))) continue;
               std::u32string_view wf;
               std::tie(std::ignore, words, std::ignore, wf) = d->UnpackChannelHeader(sv,
-                  0, 0, 0, words, channels_in_event);
+                  0, words, channels_in_event);
               vector<int> hist(0x4000, 0);
               for (auto w : wf) {
                 val0 = w&0x3FFF;
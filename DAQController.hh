@@ -8,13 +8,25 @@
 #include <vector>
 #include <cstdint>
 #include <mutex>
+#include <condition_variable>
+#include <deque>
 #include <list>
+#include <chrono>
 #include <mongocxx/collection.hpp>
 
 class StraxFormatter;
 class MongoLog;
 class Options;
 class V1724;
+class LiveDataRing;
+class ChunkStreamer;
+class CoincidenceFilter;
+class ChannelPrescaler;
+class MetricsRegistry;
+class CBLTChain;
+class ReadScheduler;
+class RawCapture;
+struct data_packet;
 
 class DAQController{
   /*
@@ -39,17 +51,42 @@ protected:
   int fStatus;
 
 private:
+  // one readout, and when it was done
+  typedef std::pair<std::unique_ptr<data_packet>, std::chrono::steady_clock::time_point> readout_t;
+  struct link_queue_t{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<readout_t>> reads; // one entry per pass over the link
+    bool done = false;
+  };
+
   void ReadData(int link);
+  void ProcessLink(int link);
+  void Dispatch(std::vector<readout_t>&, RawCapture*);
+  void SplitPacket(std::unique_ptr<data_packet>&);
   int OpenThreads();
   void CloseThreads();
   void InitLink(std::vector<std::shared_ptr<V1724>>&, std::map<int, std::vector<uint16_t>>&, int&);
   int FitBaselines(std::vector<std::shared_ptr<V1724>>&, std::map<int, std::vector<uint16_t>>&, int);
+  void SaveReport(const std::map<int, std::pair<long, long>>&, const std::map<int, int>&);
 
   std::vector<std::unique_ptr<StraxFormatter>> fFormatters;
+  std::shared_ptr<LiveDataRing> fLiveRing;
+  std::shared_ptr<ChunkStreamer> fStreamer;
+  std::shared_ptr<CoincidenceFilter> fCoincidence;
+  std::shared_ptr<ChannelPrescaler> fPrescaler;
+  std::shared_ptr<MetricsRegistry> fMetrics;
   std::vector<std::thread> fProcessingThreads;
   std::vector<std::thread> fReadoutThreads;
   std::map<int, std::vector<std::shared_ptr<V1724>>> fDigitizers;
+  std::map<int, std::vector<std::unique_ptr<CBLTChain>>> fChains; // by link, one per crate
+  std::map<int, std::unique_ptr<ReadScheduler>> fSchedulers; // by link, for what's not chained
+  std::map<int, std::unique_ptr<RawCapture>> fCaptures; // by link, if raw_capture_path is set
   std::mutex fMutex;
+  std::chrono::steady_clock::time_point fRunStart;
+  // for the deadtime fraction since the last status update
+  std::chrono::steady_clock::time_point fLastStatus;
+  std::map<int, long> fLastDeadtime;
 
   std::atomic_bool fReadLoop;
   std::map<int, std::atomic_bool> fRunning;
@@ -58,6 +95,16 @@ private:
   // For reporting to frontend
   std::atomic_int fDataRate;
   std::atomic_long fCounter;
+  std::atomic_long fSplitPackets;
+  size_t fSplitWords;
+
+  // readout_async, by link
+  std::map<int, std::unique_ptr<link_queue_t>> fLinkQueues;
+  unsigned fReadoutBuffers;
+  std::map<int, std::atomic_long> fLinkStalls; // times the queue was full
+  // ns spent in transfers, for the link utilization
+  std::map<int, std::atomic_long> fLinkBusy;
+  std::map<int, long> fLastLinkBusy;
 };
 
 #endif
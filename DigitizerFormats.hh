@@ -0,0 +1,131 @@
+#ifndef _DIGITIZERFORMATS_HH_
+#define _DIGITIZERFORMATS_HH_
+
+#include <cstdint>
+#include <string_view>
+
+// Compile-time descriptions of the data format of each board type. The
+// StraxFormatter picks one of these once per data packet and everything
+// below that is a template on it, so the header decoding is inlined into the
+// loops over events and channels instead of going through a virtual call and
+// a tuple per channel. The digitizer classes implement their Unpack*
+// functions with these too, so there's only one copy of each bit layout.
+// Boards with a format that isn't in here use GenericFormat, which goes
+// through the virtual functions like before.
+
+namespace DigitizerFormats {
+
+enum Format {kGeneric = 0, kV1724, kV1730, kV1724_MV};
+
+struct event_header_t {
+  int words;
+  int channel_mask;
+  bool fail;
+  uint32_t time;
+};
+
+struct channel_header_t {
+  int64_t timestamp; // ns
+  int words; // including the channel header
+  uint16_t baseline;
+  std::u32string_view wf;
+};
+
+// For boards with a 31-bit trigger time tag: the 64-bit time of a tag that's
+// within half a rollover (~10 s at 10 ns) of a time we already know. The
+// readout uses this to extend each event's time from the one before it, and
+// the channels then only need to be extended from the time of their event,
+// which is just an add
+inline int64_t Extend(int64_t reference, uint32_t time) {
+  return reference + (int32_t((time - uint32_t(reference)) << 1) >> 1);
+}
+
+struct V1724Format {
+  // DPP DAW firmware
+  static constexpr int kChannels = 8;
+  static constexpr int kClockWidth = 10; // ns
+  static constexpr int kSampleWidth = 10; // ns
+  static constexpr int kTimestampBits = 31;
+
+  static constexpr unsigned Channels() {return kChannels;}
+  static constexpr uint16_t SampleWidth() {return kSampleWidth;}
+  static event_header_t EventHeader(std::u32string_view sv) {
+    return {int(sv[0]&0xFFFFFFF), int(sv[1]&0xFF), (sv[1]&0x4000000) != 0, sv[3]&0x7FFFFFFF};
+  }
+  static channel_header_t ChannelHeader(std::u32string_view sv, int64_t event_time, int, int) {
+    int words = sv[0]&0x7FFFFF;
+    return {Extend(event_time, sv[1]&0x7FFFFFFF)*kClockWidth, words, 0, sv.substr(2, words-2)};
+  }
+};
+
+struct V1730Format {
+  // DPP DAW firmware, 48-bit timestamps so no rollovers to worry about
+  static constexpr int kChannels = 16;
+  static constexpr int kClockWidth = 2;
+  static constexpr int kSampleWidth = 2;
+  static constexpr int kTimestampBits = 48;
+
+  static constexpr unsigned Channels() {return kChannels;}
+  static constexpr uint16_t SampleWidth() {return kSampleWidth;}
+  static event_header_t EventHeader(std::u32string_view sv) {
+    return {int(sv[0]&0xFFFFFFF),
+            int((sv[1]&0xFF) | ((sv[2]>>16)&0xFF00)),
+            (sv[1]&0x4000000) != 0,
+            sv[3]&0x7FFFFFFF};
+  }
+  static channel_header_t ChannelHeader(std::u32string_view sv, int64_t, int, int) {
+    int words = sv[0]&0x7FFFFF;
+    return {(long(sv[1]) | (long(sv[2]&0xFFFF)<<32))*kClockWidth,
+            words,
+            uint16_t((sv[2]>>16)&0x3FFF),
+            sv.substr(3, words-3)};
+  }
+};
+
+struct V1724MVFormat {
+  // default firmware: no channel headers, every channel has the same length
+  // and the time of the event
+  static constexpr int kChannels = 8;
+  static constexpr int kClockWidth = 10;
+  static constexpr int kSampleWidth = 10;
+  static constexpr int kTimestampBits = 31;
+
+  static constexpr unsigned Channels() {return kChannels;}
+  static constexpr uint16_t SampleWidth() {return kSampleWidth;}
+  static event_header_t EventHeader(std::u32string_view sv) {
+    return V1724Format::EventHeader(sv);
+  }
+  static channel_header_t ChannelHeader(std::u32string_view sv, int64_t event_time,
+      int event_words, int n_channels) {
+    int words = (event_words-4)/n_channels;
+    return {event_time*kClockWidth, words, 0, sv.substr(0, words)};
+  }
+};
+
+template<typename Digitizer>
+class GenericFormat {
+  /*
+    Anything else, through the digitizer's virtual functions
+  */
+public:
+  GenericFormat(Digitizer* digi) : fDigi(digi) {}
+  unsigned Channels() const {return fDigi->GetNumChannels();}
+  uint16_t SampleWidth() const {return fDigi->SampleWidth();}
+  event_header_t EventHeader(std::u32string_view sv) const {
+    auto [words, mask, fail, time] = fDigi->UnpackEventHeader(sv);
+    return {words, mask, fail, time};
+  }
+  channel_header_t ChannelHeader(std::u32string_view sv, int64_t event_time, int event_words,
+      int n_channels) const {
+    auto [timestamp, words, baseline, wf] = fDigi->UnpackChannelHeader(sv, event_time,
+        event_words, n_channels);
+    return {timestamp, words, baseline, wf};
+  }
+
+private:
+  Digitizer* fDigi;
+};
+
+} // namespace DigitizerFormats
+
+#endif // _DIGITIZERFORMATS_HH_ defined
@@ -0,0 +1,59 @@
+#include "HeaderScan.hh"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HEADERSCAN_X86
+#endif
+
+static bool IsHeader(char32_t w) {return (w >> 28) == 0xA;}
+
+size_t HeaderScan::NextEvent(const char32_t* buff, size_t n, size_t start) {
+  while (start < n) {
+    if (!IsHeader(buff[start])) {
+      start += FindCandidate(buff + start, n - start);
+      if (start >= n) break;
+    }
+    // something with the right nibble can still be a sample or garbage, but
+    // then it's unlikely to also claim a size that fits
+    size_t words = buff[start]&0xFFFFFFF;
+    if (words >= kMinEventWords && words <= n - start) return start;
+    start++;
+  }
+  return n;
+}
+
+size_t HeaderScan::FindCandidate(const char32_t* buff, size_t n) {
+  static const auto find = HasAVX2() ? FindCandidateAVX2 : FindCandidateScalar;
+  return find(buff, n);
+}
+
+bool HeaderScan::HasAVX2() {
+#ifdef HEADERSCAN_X86
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+size_t HeaderScan::FindCandidateScalar(const char32_t* buff, size_t n) {
+  for (size_t i = 0; i < n; i++) if (IsHeader(buff[i])) return i;
+  return n;
+}
+
+#ifdef HEADERSCAN_X86
+__attribute__((target("avx2")))
+size_t HeaderScan::FindCandidateAVX2(const char32_t* buff, size_t n) {
+  const __m256i nibble = _mm256_set1_epi32(0xA);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i w = _mm256_srli_epi32(_mm256_loadu_si256((const __m256i*)(buff + i)), 28);
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(w, nibble)));
+    if (mask != 0) return i + __builtin_ctz(mask);
+  }
+  for (; i < n; i++) if (IsHeader(buff[i])) return i;
+  return n;
+}
+#else
+size_t HeaderScan::FindCandidateAVX2(const char32_t* buff, size_t n) {
+  return FindCandidateScalar(buff, n);
+}
+#endif
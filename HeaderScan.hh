@@ -0,0 +1,34 @@
+#ifndef _HEADERSCAN_HH_
+#define _HEADERSCAN_HH_
+
+#include <cstddef>
+
+class HeaderScan{
+  /*
+    Finds event headers in raw digitizer data. This is how the readout finds
+    every event: V1724::IndexEvents hops from one header to the next to build
+    each packet's event index, and CBLTChain::Read uses it to sort the events
+    of a chained transfer by board. Junk between events (corrupted or
+    partially read buffers) gets skipped on the way. Looks at 8 words at a
+    time with AVX2 if the cpu has it, and one at a time otherwise; which one
+    is decided once at runtime.
+  */
+
+public:
+  // Index of the first word from start on that is an event header (0xA in the
+  // top nibble) of a size that fits in what's left of the buffer, n if there's
+  // none. Returns start right away if that's already one
+  static size_t NextEvent(const char32_t* buff, size_t n, size_t start);
+  // Index of the first word with 0xA in the top nibble, n if none
+  static size_t FindCandidate(const char32_t* buff, size_t n);
+  static bool HasAVX2();
+
+  // Both implementations of FindCandidate, for tests and benchmarks. Only call
+  // the AVX2 one if HasAVX2()
+  static size_t FindCandidateScalar(const char32_t* buff, size_t n);
+  static size_t FindCandidateAVX2(const char32_t* buff, size_t n);
+
+  static const unsigned kMinEventWords = 4; // just the header
+};
+
+#endif // _HEADERSCAN_HH_ defined
@@ -0,0 +1,152 @@
+#include "LiveDataRing.hh"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <new>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+    "Shared-memory ring needs address-free 64-bit atomics");
+
+LiveDataRing::LiveDataRing(const std::string& name, long capacity) {
+  fName = name;
+  fCapacity = (capacity+7)&~7l;
+  fTooBig = 0;
+  fMapSize = sizeof(ring_header_t) + fCapacity;
+  fHeader = nullptr;
+  fRing = nullptr;
+  // if a previous run died without cleaning up, start fresh
+  shm_unlink(fName.c_str());
+  int fd = shm_open(fName.c_str(), O_CREAT | O_RDWR, 0644);
+  if (fd < 0)
+    throw std::runtime_error("Can't open shared memory " + fName);
+  if (ftruncate(fd, fMapSize)) {
+    close(fd);
+    shm_unlink(fName.c_str());
+    throw std::runtime_error("Can't resize shared memory " + fName);
+  }
+  void* addr = mmap(nullptr, fMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    shm_unlink(fName.c_str());
+    throw std::runtime_error("Can't map shared memory " + fName);
+  }
+  // ftruncate zero-fills, so all the record tags start out as 'not written'
+  fHeader = new(addr) ring_header_t;
+  fHeader->capacity = fCapacity;
+  fHeader->header_size = sizeof(ring_header_t);
+  fHeader->version = kVersion;
+  fHeader->write_head.store(0);
+  fHeader->sequence.store(0);
+  fRing = (char*)addr + sizeof(ring_header_t);
+  // readers check this last, so the rest of the header must be done first
+  std::atomic_thread_fence(std::memory_order_release);
+  fHeader->magic = kMagic;
+}
+
+LiveDataRing::~LiveDataRing() {
+  if (fHeader != nullptr) munmap(fHeader, fMapSize);
+  shm_unlink(fName.c_str());
+}
+
+void LiveDataRing::CopyIn(char* ring, uint64_t capacity, uint64_t pos, const void* src, uint64_t n) {
+  uint64_t offset = pos % capacity, first = std::min(n, capacity - offset);
+  std::memcpy(ring + offset, src, first);
+  if (first < n) std::memcpy(ring, (const char*)src + first, n - first);
+}
+
+void LiveDataRing::CopyOut(const char* ring, uint64_t capacity, uint64_t pos, void* dst, uint64_t n) {
+  uint64_t offset = pos % capacity, first = std::min(n, capacity - offset);
+  std::memcpy(dst, ring + offset, first);
+  if (first < n) std::memcpy((char*)dst + first, ring, n - first);
+}
+
+int LiveDataRing::Publish(const char* data, uint32_t bytes, uint32_t kind) {
+  // Writers only ever contend with each other on one fetch_add. The space is
+  // claimed first, then filled, then the tag is set to say the record is done.
+  // Readers compare the write head against their own position afterwards,
+  // so anyone who reads something we're in the middle of overwriting knows it.
+  uint64_t rec_size = RecordSize(bytes);
+  if (rec_size > fCapacity/2) {
+    fTooBig++;
+    return -1;
+  }
+  uint64_t pos = fHeader->write_head.fetch_add(rec_size, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  record_header_t rh{0, fHeader->sequence.fetch_add(1, std::memory_order_relaxed),
+    bytes, kind};
+  const uint64_t tag_size = sizeof(rh.tag);
+  CopyIn(fRing, fCapacity, pos + tag_size, (const char*)&rh + tag_size,
+      sizeof(rh) - tag_size);
+  CopyIn(fRing, fCapacity, pos + sizeof(rh), data, bytes);
+  auto tag = reinterpret_cast<std::atomic<uint64_t>*>(fRing + pos % fCapacity);
+  tag->store(pos+1, std::memory_order_release);
+  return 0;
+}
+
+LiveDataRingReader::LiveDataRingReader(const std::string& name) {
+  fHeader = nullptr;
+  fBytesLost = 0;
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    throw std::runtime_error("Can't open shared memory " + name);
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < (long)sizeof(LiveDataRing::ring_header_t)) {
+    close(fd);
+    throw std::runtime_error("Shared memory " + name + " isn't a ring");
+  }
+  fMapSize = st.st_size;
+  void* addr = mmap(nullptr, fMapSize, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    throw std::runtime_error("Can't map shared memory " + name);
+  fHeader = (LiveDataRing::ring_header_t*)addr;
+  if (fHeader->magic != LiveDataRing::kMagic || fHeader->version != LiveDataRing::kVersion) {
+    munmap(addr, fMapSize);
+    throw std::runtime_error("Shared memory " + name + " has the wrong format");
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  fCapacity = fHeader->capacity;
+  fRing = (const char*)addr + fHeader->header_size;
+  fReadPos = fHeader->write_head.load(std::memory_order_acquire);
+}
+
+LiveDataRingReader::~LiveDataRingReader() {
+  if (fHeader != nullptr) munmap(fHeader, fMapSize);
+}
+
+int LiveDataRingReader::Next(std::string& out, uint64_t& sequence, uint32_t& kind) {
+  uint64_t head = fHeader->write_head.load(std::memory_order_acquire);
+  if (head - fReadPos > fCapacity) {
+    fBytesLost += head - fReadPos;
+    fReadPos = head;
+    return -1;
+  }
+  if (head == fReadPos) return 0;
+  auto tag = reinterpret_cast<const std::atomic<uint64_t>*>(fRing + fReadPos % fCapacity);
+  if (tag->load(std::memory_order_acquire) != fReadPos+1) {
+    // the writer hasn't finished yet, or the slot's been recycled. The
+    // second case shows up in the head check next time around
+    return 0;
+  }
+  LiveDataRing::record_header_t rh;
+  LiveDataRing::CopyOut(fRing, fCapacity, fReadPos, &rh, sizeof(rh));
+  if (rh.bytes > fCapacity/2) rh.bytes = 0; // torn read, caught below
+  out.resize(rh.bytes);
+  LiveDataRing::CopyOut(fRing, fCapacity, fReadPos + sizeof(rh), out.data(), rh.bytes);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  head = fHeader->write_head.load(std::memory_order_relaxed);
+  if (head - fReadPos > fCapacity) {
+    // someone started overwriting this record while we were copying it
+    fBytesLost += head - fReadPos;
+    fReadPos = head;
+    return -1;
+  }
+  sequence = rh.sequence;
+  kind = rh.kind;
+  fReadPos += LiveDataRing::RecordSize(rh.bytes);
+  return 1;
+}
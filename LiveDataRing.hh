@@ -0,0 +1,84 @@
+#ifndef _LIVEDATARING_HH_
+#define _LIVEDATARING_HH_
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+
+class LiveDataRing{
+  /*
+    Shared-memory ring that the formatters publish finished fragments into,
+    so local consumers (monitors, event displays, etc) can look at the data
+    long before the chunk hits the disk. Writers never wait for readers. Any
+    number of readers can map the ring, and each one finds out by itself if
+    it got lapped by the writers.
+  */
+
+public:
+  LiveDataRing(const std::string& name, long capacity); // creates the segment
+  ~LiveDataRing();
+
+  // -1 if the record is too big for the ring (more than half of it)
+  int Publish(const char* data, uint32_t bytes, uint32_t kind=0);
+  long TooBig() {return fTooBig;}
+
+  // What lives at the front of the shared segment
+  struct ring_header_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t capacity; // bytes, multiple of 8
+    std::atomic<uint64_t> write_head; // total bytes reserved since creation
+    std::atomic<uint64_t> sequence; // total records reserved since creation
+  };
+  // What precedes each record in the ring. Records are 8-byte aligned, so the
+  // tag never straddles the end of the ring and can be used atomically
+  struct record_header_t {
+    uint64_t tag; // absolute position + 1, written last
+    uint64_t sequence;
+    uint32_t bytes;
+    uint32_t kind;
+  };
+
+  static const uint64_t kMagic = 0x5245444158524E47; // "REDAXRNG"
+  static const uint32_t kVersion = 1;
+
+  static void CopyIn(char* ring, uint64_t capacity, uint64_t pos, const void* src, uint64_t n);
+  static void CopyOut(const char* ring, uint64_t capacity, uint64_t pos, void* dst, uint64_t n);
+  static uint64_t RecordSize(uint32_t bytes) {
+    return sizeof(record_header_t) + ((bytes+7ul)&~7ul);
+  }
+
+private:
+  std::string fName;
+  size_t fMapSize;
+  ring_header_t* fHeader;
+  char* fRing;
+  uint64_t fCapacity;
+  std::atomic_long fTooBig;
+};
+
+class LiveDataRingReader{
+  /*
+    Consumer side of the LiveDataRing. Starts at the current write position,
+    so it only sees data published after it attached.
+  */
+
+public:
+  LiveDataRingReader(const std::string& name);
+  ~LiveDataRingReader();
+
+  // 1: got a record, 0: nothing new, -1: overrun (lost data, now resynced)
+  int Next(std::string& out, uint64_t& sequence, uint32_t& kind);
+  uint64_t BytesLost() {return fBytesLost;}
+
+private:
+  size_t fMapSize;
+  LiveDataRing::ring_header_t* fHeader;
+  const char* fRing;
+  uint64_t fCapacity;
+  uint64_t fReadPos;
+  uint64_t fBytesLost;
+};
+
+#endif // _LIVEDATARING_HH_ defined
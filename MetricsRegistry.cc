@@ -0,0 +1,82 @@
+#include "MetricsRegistry.hh"
+#include <algorithm>
+
+MetricsRegistry::slot_t::slot_t() {
+  for (auto& c : counters) c = 0;
+  for (auto& h : histograms) for (auto& b : h) b = 0;
+  for (auto& c : channels) c = 0;
+}
+
+MetricsRegistry::MetricsRegistry(int level) {
+  fLevel = std::clamp(level, int(kOff), REDAX_METRICS_LEVEL);
+  fLastChannel.assign(kMaxChannels, 0);
+}
+
+MetricsRegistry::~MetricsRegistry() {
+  fSlots.clear();
+}
+
+MetricsRegistry::slot_t* MetricsRegistry::Register() {
+  const std::lock_guard<std::mutex> lk(fMutex);
+  fSlots.emplace_back(std::make_unique<slot_t>());
+  return fSlots.back().get();
+}
+
+long MetricsRegistry::Get(Counter c) {
+  const std::lock_guard<std::mutex> lk(fMutex);
+  long ret = 0;
+  for (auto& s : fSlots) ret += s->counters[c].load(std::memory_order_relaxed);
+  return ret;
+}
+
+std::map<long, long> MetricsRegistry::Get(Histogram h) {
+  const std::lock_guard<std::mutex> lk(fMutex);
+  std::map<long, long> ret;
+  for (int b = 0; b < kBuckets; b++) {
+    long n = 0;
+    for (auto& s : fSlots) n += s->histograms[h][b].load(std::memory_order_relaxed);
+    if (n > 0) ret[b == 0 ? 0 : 1L << (b-1)] = n;
+  }
+  return ret;
+}
+
+void MetricsRegistry::GetDataPerChan(std::map<int, int>& ret) {
+  const std::lock_guard<std::mutex> lk(fMutex);
+  for (int ch = 0; ch < kMaxChannels; ch++) {
+    long total = 0;
+    for (auto& s : fSlots) total += s->channels[ch].load(std::memory_order_relaxed);
+    if (total == fLastChannel[ch] && fSeenChannels.count(ch) == 0) continue;
+    fSeenChannels.insert(ch);
+    ret[ch] += total - fLastChannel[ch];
+    fLastChannel[ch] = total;
+  }
+}
+
+std::string MetricsRegistry::Name(Counter c) {
+  switch (c) {
+    case kBytesProcessed: return "bytes_processed";
+    case kDataPackets: return "data_packets";
+    case kEvents: return "events";
+    case kFragments: return "fragments";
+    case kBoardFails: return "board_fails";
+    case kSkippedWords: return "skipped_words";
+    case kChunks: return "chunks";
+    case kChunkBytes: return "chunk_bytes";
+    case kCompressedBytes: return "compressed_bytes";
+    case kPacketTime: return "data_packets_ns";
+    case kEventTime: return "events_ns";
+    case kChannelTime: return "channels_ns";
+    case kChunkTime: return "chunks_ns";
+    default: return "unknown";
+  }
+}
+
+std::string MetricsRegistry::Name(Histogram h) {
+  switch (h) {
+    case kEventsPerPacket: return "events_per_packet";
+    case kFragmentsPerEvent: return "fragments_per_event";
+    case kPacketsPerTransfer: return "packets_per_transfer";
+    case kBytesPerChunk: return "bytes_per_chunk";
+    default: return "unknown";
+  }
+}
@@ -0,0 +1,126 @@
+#ifndef _METRICSREGISTRY_HH_
+#define _METRICSREGISTRY_HH_
+
+#include <cstdint>
+#include <ctime>
+#include <atomic>
+#include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <string>
+
+// Highest instrumentation level compiled in: 0 none, 1 counters, 2 counters
+// and cpu timers. The metrics_level option picks anything up to this at arm
+// time, with this the checks for the levels not compiled in go away entirely
+#ifndef REDAX_METRICS_LEVEL
+#define REDAX_METRICS_LEVEL 2
+#endif
+
+class MetricsRegistry{
+  /*
+    Counters and histograms for the processing threads. Each thread gets a
+    slot of its own, padded to whole cache lines, and is the only one
+    writing to it, so counting is a plain load and store with no locks and
+    no contended cache lines. The status thread adds up all the slots
+    whenever it wants to know something. Per-channel byte counts are always
+    kept since the status documents and the hot-channel guard need them;
+    everything else only at the selected level.
+  */
+
+public:
+  enum Level {kOff = 0, kCounters = 1, kTimers = 2};
+  enum Counter {
+    kBytesProcessed, kDataPackets, kEvents, kFragments, kBoardFails, kSkippedWords,
+    kChunks, kChunkBytes, kCompressedBytes,
+    // kTimers only, ns of thread cpu time
+    kPacketTime, kEventTime, kChannelTime, kChunkTime,
+    kNumCounters
+  };
+  enum Histogram {
+    kEventsPerPacket, kFragmentsPerEvent, kPacketsPerTransfer, kBytesPerChunk,
+    kNumHistograms
+  };
+  static const int kBuckets = 40; // log2, the last one takes everything bigger
+  static const int kMaxChannels = 4096;
+
+  struct alignas(64) slot_t {
+    slot_t();
+    void Add(Counter c, long n) {
+      counters[c].store(counters[c].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    void Fill(Histogram h, unsigned long x) {
+      auto& b = histograms[h][Bucket(x)];
+      b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    void AddChannel(int16_t ch, long bytes) {
+      if (ch < 0 || ch >= kMaxChannels) return;
+      channels[ch].store(channels[ch].load(std::memory_order_relaxed) + bytes,
+          std::memory_order_relaxed);
+    }
+    std::atomic_long counters[kNumCounters];
+    std::atomic_long histograms[kNumHistograms][kBuckets];
+    std::atomic_long channels[kMaxChannels];
+  };
+
+  MetricsRegistry(int level);
+  ~MetricsRegistry();
+
+  // Call once from each thread that wants to count something. The slot lives
+  // as long as the registry does
+  slot_t* Register();
+
+  bool Counting() const {return REDAX_METRICS_LEVEL >= kCounters && fLevel >= kCounters;}
+  bool Timing() const {return REDAX_METRICS_LEVEL >= kTimers && fLevel >= kTimers;}
+  int GetLevel() const {return fLevel;}
+
+  // Totals over all threads
+  long Get(Counter);
+  // {lower edge of bucket: entries} for the non-empty buckets
+  std::map<long, long> Get(Histogram);
+  // Only from the status thread: bytes per channel since the last call.
+  // Channels that have seen data once keep showing up, with 0 if need be
+  void GetDataPerChan(std::map<int, int>& ret);
+
+  static int Bucket(unsigned long x) {
+    // 0 goes in 0, [2^(i-1), 2^i) in i
+    int b = x == 0 ? 0 : 64 - __builtin_clzl(x);
+    return b < kBuckets ? b : kBuckets-1;
+  }
+  static std::string Name(Counter);
+  static std::string Name(Histogram);
+  // thread cpu time in ns
+  static long CpuTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec*1000000000L + ts.tv_nsec;
+  }
+
+private:
+  int fLevel;
+  std::vector<std::unique_ptr<slot_t>> fSlots;
+  std::mutex fMutex; // only for the list of slots, not what's in them
+  std::vector<long> fLastChannel; // totals as of the last GetDataPerChan
+  std::set<int> fSeenChannels;
+};
+
+class CpuTimer{
+  /*
+    Adds the thread cpu time between construction and destruction to a
+    counter, or does nothing at all if timers are off
+  */
+public:
+  CpuTimer(MetricsRegistry::slot_t* slot, MetricsRegistry::Counter c, bool on) :
+    fSlot(REDAX_METRICS_LEVEL >= MetricsRegistry::kTimers && on ? slot : nullptr), fCounter(c), fStart(0) {
+    if (fSlot) fStart = MetricsRegistry::CpuTime();
+  }
+  ~CpuTimer() {if (fSlot) fSlot->Add(fCounter, MetricsRegistry::CpuTime() - fStart);}
+
+private:
+  MetricsRegistry::slot_t* fSlot;
+  MetricsRegistry::Counter fCounter;
+  long fStart;
+};
+
+#endif // _METRICSREGISTRY_HH_ defined
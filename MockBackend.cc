@@ -0,0 +1,323 @@
+#include "MockBackend.hh"
+#include "Options.hh"
+#include "DigitizerFormats.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+MockBackend::MockBackend(std::shared_ptr<Options>& opts) {
+  fLatency = std::max(0., opts->GetDouble("mock_latency_us", 2))*1e-6;
+  fBandwidth = std::max(1., opts->GetDouble("mock_bandwidth_mb", 80))*1e6;
+  fRate = std::max(0., opts->GetDouble("mock_event_rate", 1000));
+  fMemoryWords = std::max(1, opts->GetInt("mock_memory_mb", 8))*(1ul<<20)/sizeof(char32_t);
+  int samples = std::max(2, opts->GetInt("mock_samples", 100)) & ~1;
+  // a flat baseline with a pulse in the middle, two samples per word
+  for (int i = 0; i < samples; i += 2) {
+    uint32_t word = 0;
+    for (int j = 0; j < 2; j++) {
+      int x = i + j - samples/2;
+      uint32_t sample = 16000 - (x >= 0 && x < 20 ? 2000*std::exp(-x/5.) : 0);
+      word |= (sample & 0x3FFF) << (16*j);
+    }
+    fSamples += char32_t(word);
+  }
+  for (auto& d : opts->GetBoards("V17XX")) {
+    if (d.type == "f1724") continue;
+    board_t b;
+    b.link = d.link;
+    b.crate = d.crate;
+    b.bid = d.board;
+    b.base = d.vme_address & 0xFFFF0000;
+    if (d.type == "V1730") {
+      b.format = kDAW1730;
+      b.clock_width = DigitizerFormats::V1730Format::kClockWidth;
+    } else {
+      b.format = d.type == "V1724_MV" ? kDefault1724 : kDAW1724;
+      b.clock_width = DigitizerFormats::V1724Format::kClockWidth;
+    }
+    Reset(b);
+    fBoards.push_back(std::move(b));
+    LinkMutex(d.link);
+  }
+}
+
+MockBackend::~MockBackend() {
+  fBoards.clear();
+}
+
+std::mutex& MockBackend::LinkMutex(int link) {
+  const std::lock_guard<std::mutex> lg(fMutex);
+  auto& m = fLinkMutex[link];
+  if (!m) m = std::make_unique<std::mutex>();
+  return *m;
+}
+
+MockBackend::handle_t* MockBackend::Handle(int handle) {
+  const std::lock_guard<std::mutex> lg(fMutex);
+  if (handle < 0 || handle >= (int)fHandles.size() || !fHandles[handle].open) return nullptr;
+  return &fHandles[handle];
+}
+
+MockBackend::board_t* MockBackend::Find(const handle_t& h, uint32_t address) {
+  for (auto& b : fBoards)
+    if (b.link == h.link && b.crate == h.crate && b.base == (address & 0xFFFF0000)) return &b;
+  return nullptr;
+}
+
+void MockBackend::Spend(double seconds) {
+  // sleeping is only good to ~50 us, the rest we wait out
+  auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+  if (seconds > 200e-6)
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds - 100e-6));
+  while (std::chrono::steady_clock::now() < end) {}
+}
+
+void MockBackend::Reset(board_t& b) {
+  b.registers.clear();
+  b.registers[0x8120] = b.format == kDAW1730 ? 0xFFFF : 0xFF; // all channels on
+  b.running = false;
+  Clear(b);
+}
+
+void MockBackend::Clear(board_t& b) {
+  b.start = std::chrono::steady_clock::now();
+  b.triggers = 0;
+  b.event_counter = 0;
+  b.memory.clear();
+  b.read_pos = 0;
+  b.events.clear();
+}
+
+void MockBackend::AddEvent(board_t& b, long clock) {
+  // The event counter only counts events that made it into the memory, so
+  // the readout won't see a gap for the ones that didn't
+  uint32_t mask = b.registers[0x8120] & (b.format == kDAW1730 ? 0xFFFF : 0xFF);
+  int channels = __builtin_popcount(mask);
+  int header = b.format == kDAW1724 ? 2 : (b.format == kDAW1730 ? 3 : 0);
+  uint32_t words = 4 + channels*(header + fSamples.size());
+  if (b.memory.size() - b.read_pos + words > fMemoryWords) return;
+  uint32_t board_id = b.registers[0xEF08] & 0x1F;
+  b.memory += char32_t(0xA0000000 | words);
+  b.memory += char32_t((board_id << 27) | (mask & 0xFF));
+  b.memory += char32_t((b.event_counter & 0xFFFFFF) | ((mask & 0xFF00) << 16));
+  b.memory += char32_t(clock & 0x7FFFFFFF);
+  for (int ch = 0; ch < channels; ch++) {
+    if (b.format == kDAW1724) {
+      b.memory += char32_t(header + fSamples.size());
+      b.memory += char32_t(clock & 0x7FFFFFFF);
+    } else if (b.format == kDAW1730) {
+      b.memory += char32_t(header + fSamples.size());
+      b.memory += char32_t(clock & 0xFFFFFFFF);
+      b.memory += char32_t(((clock >> 32) & 0xFFFF) | (16000u << 16));
+    }
+    b.memory += fSamples;
+  }
+  b.events.push_back(words);
+  b.event_counter++;
+}
+
+void MockBackend::Fill(board_t& b) {
+  // Triggers come at fixed intervals since the start, so however long it
+  // was since we last looked, the board has what it would have had
+  if (!b.running || fRate <= 0) return;
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - b.start).count();
+  long target = elapsed*fRate;
+  for (; b.triggers < target; b.triggers++) {
+    if (b.memory.size() - b.read_pos >= fMemoryWords) {
+      b.triggers = target; // full, these are all lost
+      break;
+    }
+    AddEvent(b, std::lround(b.triggers/fRate*1e9/b.clock_width));
+  }
+}
+
+uint32_t MockBackend::Status(board_t& b) {
+  // running, event ready, memory full, PLL locked, board ready
+  size_t stored = b.memory.size() - b.read_pos;
+  size_t event = 4 + 16*(3 + fSamples.size()); // biggest there could be
+  return (b.running ? 0x4 : 0) | (stored > 0 ? 0x8 : 0) |
+    (stored + event > fMemoryWords ? 0x10 : 0) | 0x80 | 0x100;
+}
+
+size_t MockBackend::Take(board_t& b, char32_t* buffer, size_t words) {
+  size_t n = std::min(words, b.memory.size() - b.read_pos);
+  std::memcpy(buffer, b.memory.data() + b.read_pos, n*sizeof(char32_t));
+  b.read_pos += n;
+  for (size_t left = n; left > 0 && b.events.size() > 0;) {
+    size_t part = std::min<size_t>(left, b.events.front());
+    left -= part;
+    if ((b.events.front() -= part) == 0) b.events.pop_front();
+  }
+  if (b.read_pos == b.memory.size()) {
+    b.memory.clear();
+    b.read_pos = 0;
+  } else if (b.read_pos > b.memory.size()/2) {
+    b.memory.erase(0, b.read_pos);
+    b.read_pos = 0;
+  }
+  return n;
+}
+
+int MockBackend::Init(int link, int crate, int& handle) {
+  LinkMutex(link);
+  const std::lock_guard<std::mutex> lg(fMutex);
+  handle = fHandles.size();
+  fHandles.push_back({link, crate, true, 0, 0});
+  return kSuccess;
+}
+
+int MockBackend::End(int handle) {
+  handle_t* h = Handle(handle);
+  if (h == nullptr) return kGenericError;
+  h->open = false;
+  return kSuccess;
+}
+
+int MockBackend::ReadRegister(int handle, uint32_t address, uint32_t& value) {
+  handle_t* h = Handle(handle);
+  if (h == nullptr) return kCommError;
+  const std::lock_guard<std::mutex> lg(LinkMutex(h->link));
+  Spend(fLatency);
+  board_t* b = Find(*h, address);
+  if (b == nullptr) return kBusError;
+  uint32_t reg = address & 0xFFFF;
+  Fill(*b);
+  if (reg == 0x8104) value = Status(*b);
+  else if (reg == 0x812C) value = b->events.size();
+  else if (reg == 0x814C) value = b->events.empty() ? 0 : b->events.front();
+  else if (reg == 0xEF04) value = b->events.empty() ? 0 : 0x1;
+  else if (reg == 0x8178) value = 0;
+  else if (reg == 0xF080) value = (b->bid >> 8) & 0xFF;
+  else if (reg == 0xF084) value = b->bid & 0xFF;
+  else if ((reg & 0xF0FF) == 0x1088) value = 0; // channel status, never busy
+  else value = b->registers.count(reg) ? b->registers[reg] : 0;
+  return kSuccess;
+}
+
+int MockBackend::WriteRegister(int handle, uint32_t address, uint32_t value) {
+  handle_t* h = Handle(handle);
+  if (h == nullptr) return kCommError;
+  const std::lock_guard<std::mutex> lg(LinkMutex(h->link));
+  Spend(fLatency);
+  board_t* b = Find(*h, address);
+  if (b == nullptr) return kBusError;
+  uint32_t reg = address & 0xFFFF;
+  if (reg == 0xEF24) {
+    Reset(*b);
+    return kSuccess;
+  }
+  if (reg == 0xEF28) {
+    Clear(*b);
+    return kSuccess;
+  }
+  if (reg == 0x8108) {
+    Fill(*b);
+    if (b->running) AddEvent(*b, std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - b->start).count()/b->clock_width);
+    return kSuccess;
+  }
+  b->registers[reg] = value;
+  if (reg == 0x8100) {
+    // S-IN or not, we start right away
+    bool run = value & 0x4;
+    if (run && !b->running) {
+      Clear(*b);
+      b->running = true;
+    } else if (!run && b->running) {
+      Fill(*b);
+      b->running = false;
+    }
+  }
+  return kSuccess;
+}
+
+int MockBackend::BLTRead(int handle, uint32_t address, void* buffer, int size, int& bytes) {
+  bytes = 0;
+  handle_t* h = Handle(handle);
+  if (h == nullptr) return kCommError;
+  const std::lock_guard<std::mutex> lg(LinkMutex(h->link));
+  std::vector<board_t*> boards;
+  if (board_t* b = Find(*h, address); b != nullptr) {
+    boards.push_back(b);
+  } else {
+    // a CBLT chain: first, the ones in between, last
+    for (unsigned position : {0x2u, 0x3u, 0x1u})
+      for (auto& b : fBoards)
+        if (b.link == h->link && b.crate == h->crate &&
+            (b.registers[0xEF0C] & 0xFF) == (address >> 24) &&
+            ((b.registers[0xEF0C] >> 8) & 0x3) == position)
+          boards.push_back(&b);
+  }
+  if (boards.empty()) {
+    Spend(fLatency);
+    return kBusError;
+  }
+  // A chain carries on with the board it stopped at, the ones before it
+  // have to wait until the last one is done
+  size_t& first = fChainPosition[{h->link, h->crate, address}];
+  size_t words = size/sizeof(char32_t), n = 0;
+  for (size_t i = boards.size() > 1 ? first : 0; i < boards.size(); i++) {
+    Fill(*boards[i]);
+    n += Take(*boards[i], (char32_t*)buffer + n, words - n);
+    if (n == words) {
+      first = i;
+      break;
+    }
+  }
+  if (n < words) first = 0;
+  bytes = n*sizeof(char32_t);
+  Spend(fLatency + bytes/fBandwidth);
+  // the bus error comes once there's nothing left
+  return n < words ? kBusError : kSuccess;
+}
+
+int MockBackend::IRQEnable(int handle, uint32_t mask) {
+  handle_t* h = Handle(handle);
+  if (h == nullptr) return kCommError;
+  h->irq_mask = mask & 0x7F;
+  return kSuccess;
+}
+
+int MockBackend::IRQWait(int handle, uint32_t mask, uint32_t timeout_ms) {
+  // A board asks for an interrupt at the level in its VME control register
+  // once it has as many events as 0xEF18 says
+  handle_t* h = Handle(handle);
+  if (h == nullptr) return kCommError;
+  mask &= h->irq_mask;
+  auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  do {
+    {
+      const std::lock_guard<std::mutex> lg(LinkMutex(h->link));
+      for (auto& b : fBoards) {
+        if (b.link != h->link || b.crate != h->crate) continue;
+        int level = b.registers[0xEF00] & 0x7;
+        if (level == 0 || !(mask & (1 << (level-1)))) continue;
+        Fill(b);
+        if (b.events.size() > 0 && b.events.size() >= b.registers[0xEF18]) return kSuccess;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  } while (std::chrono::steady_clock::now() < end);
+  return kGenericError;
+}
+
+int MockBackend::SetOutputConf(int handle, int output, OutputSource) {
+  if (Handle(handle) == nullptr) return kCommError;
+  return output >= 0 && output <= 4 ? kSuccess : kGenericError;
+}
+
+int MockBackend::SetOutputRegister(int handle, uint32_t outputs) {
+  handle_t* h = Handle(handle);
+  if (h == nullptr) return kCommError;
+  h->outputs = outputs & 0x1F;
+  return kSuccess;
+}
+
+int MockBackend::StartPulser(int handle, uint32_t, uint32_t, TimeUnit) {
+  return Handle(handle) == nullptr ? kCommError : kSuccess;
+}
+
+int MockBackend::StopPulser(int handle) {
+  return Handle(handle) == nullptr ? kCommError : kSuccess;
+}
@@ -0,0 +1,94 @@
+#ifndef _MOCKBACKEND_HH_
+#define _MOCKBACKEND_HH_
+
+#include "VMEBackend.hh"
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+class MockBackend : public VMEBackend{
+  /*
+    The digitizers in the options, in memory, for running the readout on any
+    box. Each one answers at its link, crate and base address and looks
+    enough like a V1724, V1724_MV or V1730 for the readout: registers keep
+    what's written to them, the acquisition status follows the control
+    register, and while running the board triggers itself mock_event_rate
+    times a second, filling its memory with events in its data format until
+    that's full. FIFO BLTs (chained ones too) take events out until the bus
+    error. Every access takes mock_latency_us and BLTs also their size at
+    mock_bandwidth_mb, with the link to themselves meanwhile, so boards on a
+    link share the bandwidth like they do on a fiber. There are no real
+    waveforms, so baseline fitting won't get anywhere. Outputs and pulser
+    only remember what they were told.
+  */
+
+public:
+  MockBackend(std::shared_ptr<Options>&);
+  virtual ~MockBackend();
+
+  virtual int Init(int link, int crate, int& handle);
+  virtual int End(int handle);
+  virtual int ReadRegister(int handle, uint32_t address, uint32_t& value);
+  virtual int WriteRegister(int handle, uint32_t address, uint32_t value);
+  virtual int BLTRead(int handle, uint32_t address, void* buffer, int size, int& bytes);
+  virtual int IRQEnable(int handle, uint32_t mask);
+  virtual int IRQWait(int handle, uint32_t mask, uint32_t timeout_ms);
+  virtual int SetOutputConf(int handle, int output, OutputSource);
+  virtual int SetOutputRegister(int handle, uint32_t outputs);
+  virtual int StartPulser(int handle, uint32_t period, uint32_t width, TimeUnit);
+  virtual int StopPulser(int handle);
+
+private:
+  enum Format {kDAW1724, kDAW1730, kDefault1724};
+  struct board_t {
+    int link, crate, bid;
+    uint32_t base;
+    Format format;
+    int clock_width; // ns
+    std::map<uint32_t, uint32_t> registers;
+    bool running;
+    std::chrono::steady_clock::time_point start;
+    long triggers; // since the start, including the ones that didn't fit
+    uint32_t event_counter;
+    std::u32string memory; // the events not read yet start at read_pos
+    size_t read_pos;
+    std::deque<uint32_t> events; // words left of each of them, front first
+  };
+  struct handle_t {
+    int link, crate;
+    bool open;
+    uint32_t irq_mask, outputs;
+  };
+
+  // Only with the link's mutex held
+  void Fill(board_t&);
+  void AddEvent(board_t&, long clock);
+  uint32_t Status(board_t&);
+  // Takes up to words from the front of the board's memory
+  size_t Take(board_t&, char32_t* buffer, size_t words);
+  void Reset(board_t&);
+  void Clear(board_t&);
+  // Keeps the link busy this long
+  void Spend(double seconds);
+
+  board_t* Find(const handle_t&, uint32_t address);
+  handle_t* Handle(int handle);
+  std::mutex& LinkMutex(int link);
+
+  std::vector<board_t> fBoards;
+  std::deque<handle_t> fHandles; // so they stay put as more get added
+  // {link, crate, address}: where in the chain the next CBLT starts
+  std::map<std::tuple<int, int, uint32_t>, size_t> fChainPosition;
+  std::map<int, std::unique_ptr<std::mutex>> fLinkMutex;
+  std::mutex fMutex; // for the two above
+  std::u32string fSamples; // one channel's worth, the same for all
+  double fLatency, fBandwidth; // s, bytes/s
+  double fRate; // per board, Hz
+  size_t fMemoryWords;
+};
+
+#endif // _MOCKBACKEND_HH_ defined
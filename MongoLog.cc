@@ -4,7 +4,7 @@
 #include <bsoncxx/builder/stream/document.hpp>
 
 MongoLog::MongoLog(int DeleteAfterDays, std::shared_ptr<mongocxx::pool>& pool, std::string dbname, std::string log_dir, std::string host) : 
-  fPool(pool), fClient(pool->acquire()) {
+  fPool(pool), fClient(pool ? pool->acquire() : mongocxx::pool::entry{}) {
   fLogLevel = 0;
   fHostname = host;
   fDeleteAfterDays = DeleteAfterDays;
@@ -12,8 +12,10 @@ MongoLog::MongoLog(int DeleteAfterDays, std::shared_ptr<mongocxx::pool>& pool, s
   fOutputDir = log_dir;
   //fPool = pool;
   //fClient = pool->acquire();
-  fDB = (*fClient)[dbname];
-  fCollection = fDB["log"];
+  if (fClient) {
+    fDB = (*fClient)[dbname];
+    fCollection = fDB["log"];
+  }
 
   std::cout<<"Configured WITH local file logging to " << log_dir << std::endl;
   fFlush = true;
@@ -111,7 +113,7 @@ int MongoLog::Entry(int priority, std::string message, ...){
   std::cout << msg.str();
   if (Today(&tm) != fToday) RotateLogFile();
   fOutfile<<msg.str();
-  if(priority >= fLogLevel){
+  if(priority >= fLogLevel && fClient){
     try{
       auto d = bsoncxx::builder::stream::document{} <<
         "user" << fHostname <<
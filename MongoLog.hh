@@ -56,6 +56,7 @@ class MongoLog{
   */
 
 public:
+  // Without a pool it only logs locally (for the offline tools)
   MongoLog(int DeleteAfterDays, std::shared_ptr<mongocxx::pool>&, std::string, std::string, std::string);
   ~MongoLog();
   
@@ -23,6 +23,21 @@ Options::Options(std::shared_ptr<MongoLog>& log, std::string options_name, std::
   fDAC_collection = fDB["dac_calibration"];
 }
 
+Options::Options(std::shared_ptr<MongoLog>& log, const std::string& json, std::string hostname) :
+    fLog(log), fHostname(hostname) {
+  try{
+    bson_value = new bsoncxx::document::value(bsoncxx::from_json(json));
+  }catch(const std::exception& e){
+    throw std::runtime_error(std::string("Can't parse options: ") + e.what());
+  }
+  bson_options = bson_value->view();
+  try{
+    fDetector = bson_options["detectors"][fHostname].get_utf8().value.to_string();
+  }catch(const std::exception& e){
+    throw std::runtime_error("No detector specified for this host");
+  }
+}
+
 Options::~Options(){
   if(bson_value != NULL) {
     delete bson_value;
@@ -218,6 +233,20 @@ std::vector<u_int16_t> Options::GetThresholds(int board) {
   }
 }
 
+std::map<int, int> Options::GetChannelPrescales() {
+  // {channel: factor} for every channel in "channel_prescale"
+  std::map<int, int> ret;
+  try{
+    for (auto& el : bson_options["channel_prescale"].get_document().view())
+      ret[std::stoi(el.key().to_string())] = el.get_int32().value;
+  }
+  catch(std::exception& e){
+    if (ret.size() > 0)
+      fLog->Entry(MongoLog::Warning, "Couldn't read all of channel_prescale");
+  }
+  return ret;
+}
+
 int Options::GetCrateOpt(CrateOptions &ret){
   if ((ret.pulser_freq = GetNestedInt("V2718."+fDetector+".pulser_freq", -1)) == -1) {
     try{
@@ -288,6 +317,7 @@ int Options::GetFaxOptions(fax_options_t& opts) {
 std::vector<uint16_t> Options::GetDAC(int bid, int num_chan, uint16_t default_value) {
   using namespace bsoncxx::builder::stream;
   std::vector<uint16_t> ret(num_chan, default_value);
+  if (!fClient) return ret;
   auto sort_order = document{} << "_id" << -1 << finalize;
   auto q = document{} << std::to_string(bid) << open_document << "$exists" << 1 << close_document << finalize;
   auto opts = mongocxx::options::find{};
@@ -311,6 +341,7 @@ std::vector<uint16_t> Options::GetDAC(int bid, int num_chan, uint16_t default_va
 
 void Options::UpdateDAC(std::map<int, std::vector<uint16_t>>& all_dacs){
   using namespace bsoncxx::builder::stream;
+  if (!fClient) return;
   int run_id = GetInt("number", -1);
   fLog->Entry(MongoLog::Local, "Saving DAC calibration");
   auto search_doc = document{} << "run" << run_id << finalize;
@@ -330,3 +361,22 @@ void Options::UpdateDAC(std::map<int, std::vector<uint16_t>>& all_dacs){
   return;
 }
 
+void Options::SaveBenchmarks(bsoncxx::document::value&& report) {
+  // One document per host per run, replacing whatever this host wrote for this run before
+  using namespace bsoncxx::builder::stream;
+  if (!fClient) {
+    fBenchmarks = std::make_unique<bsoncxx::document::value>(std::move(report));
+    return;
+  }
+  auto search_doc = document{} << "run" << GetInt("number", -1) << "host" << fHostname << finalize;
+  mongocxx::options::replace options;
+  options.upsert(true);
+  try{
+    fDB[GetString("performance_collection", "performance")].replace_one(std::move(search_doc),
+        std::move(report), options);
+  }catch(const std::exception& e){
+    fLog->Entry(MongoLog::Warning, "Couldn't save performance report: %s", e.what());
+  }
+  return;
+}
+
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <fstream>
 #include <streambuf>
 #include <iostream>
@@ -71,6 +72,9 @@ class Options{
 
 public:
   Options(std::shared_ptr<MongoLog>&, std::string, std::string, mongocxx::collection*, std::shared_ptr<mongocxx::pool>&, std::string, std::string);
+  // The whole run mode as one JSON document, without a database (for the
+  // offline tools). No cached baselines, and the performance report stays here
+  Options(std::shared_ptr<MongoLog>&, const std::string& json, std::string hostname);
   ~Options();
 
   int GetInt(std::string, int=-1);
@@ -87,9 +91,13 @@ public:
   int16_t GetChannel(int, int);
   int GetNestedInt(std::string, int);
   std::vector<uint16_t> GetThresholds(int);
+  std::map<int, int> GetChannelPrescales();
   int GetFaxOptions(fax_options_t&);
 
   void UpdateDAC(std::map<int, std::vector<uint16_t>>&);
+  void SaveBenchmarks(bsoncxx::document::value&&);
+  // What SaveBenchmarks got last, without a database
+  const bsoncxx::document::value* GetBenchmarks() {return fBenchmarks.get();}
 
 private:
   int Load(std::string, mongocxx::collection*, std::string);
@@ -102,6 +110,7 @@ private:
   mongocxx::pool::entry fClient; // yes
   mongocxx::database fDB;
   mongocxx::collection fDAC_collection;
+  std::unique_ptr<bsoncxx::document::value> fBenchmarks;
 };
 
 #endif
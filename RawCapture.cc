@@ -0,0 +1,116 @@
+#include "RawCapture.hh"
+#include "StraxFormatter.hh"
+#include "V1724.hh"
+#include "MongoLog.hh"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+RawCapture::RawCapture(const std::string& filename, int link, long max_bytes,
+    long block_bytes, std::shared_ptr<MongoLog>& log) {
+  fFilename = filename;
+  fLog = log;
+  fMaxBytes = max_bytes;
+  fBlockBytes = block_bytes;
+  fQueuedBytes = 0;
+  fFailed = false;
+  fSequence = 0;
+  fDropped = 0;
+  fRecords = fBytesWritten = 0;
+  fEpoch = std::chrono::system_clock::now().time_since_epoch() -
+    std::chrono::steady_clock::now().time_since_epoch();
+  if ((fFD = open(fFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+    throw std::runtime_error("Can't open " + fFilename + ": " + std::strerror(errno));
+  fBlock.reserve(fBlockBytes + sizeof(record_header_t));
+  file_header_t header{kMagic, kVersion, sizeof(file_header_t), link, sizeof(record_header_t)};
+  fBlock.append((const char*)&header, sizeof(header));
+  fRun = true;
+  fWriteThread = std::thread(&RawCapture::Write, this);
+}
+
+RawCapture::~RawCapture() {
+  {
+    const std::lock_guard<std::mutex> lg(fMutex);
+    fRun = false;
+  }
+  fCV.notify_one();
+  if (fWriteThread.joinable()) fWriteThread.join();
+  close(fFD);
+  fLog->Entry(MongoLog::Local, "Raw capture %s: %li readouts, %.1f MB, %li dropped",
+      fFilename.c_str(), fRecords, fBytesWritten/1e6, fDropped.load());
+}
+
+bool RawCapture::Add(const data_packet& dp, std::chrono::steady_clock::time_point read_time) {
+  record_header_t header{fSequence++,
+    std::chrono::duration_cast<std::chrono::nanoseconds>(read_time.time_since_epoch() + fEpoch).count(),
+    dp.times.empty() ? -1 : dp.times.front(), dp.digi->bid(), uint32_t(dp.digi->GetFormat()),
+    uint32_t(dp.digi->GetClockWidth()), uint32_t(dp.buff.size())};
+  long bytes = dp.buff.size()*sizeof(char32_t);
+  {
+    const std::lock_guard<std::mutex> lg(fMutex);
+    if (fFailed || fQueuedBytes + bytes > fMaxBytes) {
+      fDropped++;
+      return false;
+    }
+    fQueue.push_back({header, dp.storage, dp.buff});
+    fQueuedBytes += bytes;
+  }
+  fCV.notify_one();
+  return true;
+}
+
+void RawCapture::Write() {
+  // this func runs in its own thread. Takes everything queued at once and
+  // only goes to the disk with full blocks, or when it's been quiet a while
+  std::deque<record_t> records;
+  const char zeros[8] = {};
+  while (true) {
+    std::unique_lock<std::mutex> lk(fMutex);
+    bool quiet = !fCV.wait_for(lk, std::chrono::seconds(1),
+        [&]{return fQueue.size() > 0 || !fRun;});
+    records.swap(fQueue);
+    bool done = !fRun && records.empty();
+    lk.unlock();
+    for (auto& r : records) {
+      size_t bytes = r.data.size()*sizeof(char32_t);
+      if (fFailed) {
+        fDropped++;
+      } else {
+        fBlock.append((const char*)&r.header, sizeof(r.header));
+        fBlock.append((const char*)r.data.data(), bytes);
+        fBlock.append(zeros, (8 - bytes%8)%8);
+        fRecords++;
+        if ((long)fBlock.size() >= fBlockBytes) Flush();
+      }
+      r.storage.reset();
+      lk.lock();
+      fQueuedBytes -= bytes;
+      lk.unlock();
+    }
+    records.clear();
+    if ((quiet || done) && !fFailed) Flush();
+    if (done) break;
+  }
+}
+
+bool RawCapture::Flush() {
+  size_t written = 0;
+  while (written < fBlock.size()) {
+    ssize_t ret = write(fFD, fBlock.data() + written, fBlock.size() - written);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret < 0) {
+      // everything from here on would be lost anyway
+      fLog->Entry(MongoLog::Warning, "Raw capture to %s failed: %s, stopping it",
+          fFilename.c_str(), std::strerror(errno));
+      fFailed = true;
+      fBlock.clear();
+      return false;
+    }
+    written += ret;
+  }
+  fBytesWritten += written;
+  fBlock.clear();
+  return true;
+}
@@ -0,0 +1,88 @@
+#ifndef _RAWCAPTURE_HH_
+#define _RAWCAPTURE_HH_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <memory>
+#include <chrono>
+
+class MongoLog;
+struct data_packet;
+
+class RawCapture{
+  /*
+    Everything one link read this run, exactly as the boards sent it, in one
+    file: each readout with the board it came from, the time of its first
+    event and when it was read. Add only queues the packet's storage (no
+    copy) and a thread of its own packs them into big blocks for the disk.
+    The queue holds at most so many bytes, and whatever doesn't fit is lost
+    rather than held up, so the readout never waits on the disk. Lost records
+    leave a gap in the sequence numbers.
+
+    File: file_header_t, then one record_header_t and words*4 bytes of data
+    (padded to 8) per readout
+  */
+
+public:
+  RawCapture(const std::string& filename, int link, long max_bytes, long block_bytes,
+      std::shared_ptr<MongoLog>&);
+  ~RawCapture();
+
+  // One thread only, after IndexEvents and before the packet gets split.
+  // false if it didn't fit
+  bool Add(const data_packet&, std::chrono::steady_clock::time_point read_time);
+  long RecordsDropped() {return fDropped;}
+
+  struct file_header_t {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    int32_t link;
+    uint32_t record_header_size;
+  };
+  struct record_header_t {
+    uint64_t sequence; // per link, counting the ones that were dropped
+    int64_t read_time; // ns since the epoch
+    int64_t clock; // first event's 64-bit time in clock cycles, -1 if no events
+    int32_t bid;
+    uint32_t format; // DigitizerFormats::Format
+    uint32_t clock_width; // ns
+    uint32_t words;
+  };
+  static const uint64_t kMagic = 0x5245444158524157; // "REDAXRAW"
+  static const uint32_t kVersion = 1;
+
+private:
+  struct record_t {
+    record_header_t header;
+    std::shared_ptr<const std::u32string> storage;
+    std::u32string_view data;
+  };
+  void Write();
+  bool Flush();
+
+  std::string fFilename;
+  int fFD;
+  long fMaxBytes, fBlockBytes;
+  std::string fBlock;
+  std::deque<record_t> fQueue;
+  long fQueuedBytes;
+  std::mutex fMutex;
+  std::condition_variable fCV;
+  std::atomic_bool fRun;
+  std::atomic_bool fFailed;
+  uint64_t fSequence;
+  std::atomic_long fDropped;
+  long fRecords, fBytesWritten;
+  std::chrono::nanoseconds fEpoch; // system_clock - steady_clock
+  std::thread fWriteThread;
+  std::shared_ptr<MongoLog> fLog;
+};
+
+#endif // _RAWCAPTURE_HH_ defined
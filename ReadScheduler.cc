@@ -0,0 +1,78 @@
+#include "ReadScheduler.hh"
+#include "V1724.hh"
+#include "Options.hh"
+#include <algorithm>
+
+ReadScheduler::ReadScheduler(const std::vector<std::shared_ptr<V1724>>& boards,
+    std::shared_ptr<Options>& opts) {
+  fBoards = boards;
+  unsigned n = fBoards.size();
+  fPriority = opts->GetInt("read_priority", 0) == 1;
+  // n-1 is round robin, anything less is impossible
+  fMaxSkip = std::max<int>(n > 0 ? n-1 : 0, opts->GetInt("read_max_skip", 2*n));
+  fCurrent = -1;
+  fScore.assign(n, 0.);
+  fAge.assign(n, 0);
+  fLastRead.assign(n, std::chrono::steady_clock::now());
+  fMaxWait = std::make_unique<std::atomic_long[]>(n);
+  for (unsigned i = 0; i < n; i++) fMaxWait[i] = 0;
+  fRunMaxWait.assign(n, 0);
+}
+
+ReadScheduler::~ReadScheduler() {
+  fMaxWait.reset();
+}
+
+std::shared_ptr<V1724>& ReadScheduler::Next() {
+  int n = fBoards.size();
+  int next = (fCurrent + 1) % n;
+  if (fPriority) {
+    int oldest = next, full = -1, best = next;
+    double best_priority = -1;
+    for (int i = 0; i < n; i++) {
+      if (fAge[i] > fAge[oldest]) oldest = i;
+      if (fBoards[i]->IsFull() && (full < 0 || fAge[i] > fAge[full])) full = i;
+      if (double p = (fScore[i] + kFloor)*(1 + fAge[i]); p > best_priority) {
+        best_priority = p;
+        best = i;
+      }
+    }
+    next = full >= 0 ? full : best;
+    // Reading that one must still leave a way to get to everyone else in
+    // time: the k-th most urgent of the others needs at least k+1 reads of
+    // slack. If not, oldest first, which always works
+    fSlack.clear();
+    for (int i = 0; i < n; i++) if (i != next) fSlack.push_back(fMaxSkip - fAge[i]);
+    std::sort(fSlack.begin(), fSlack.end());
+    for (unsigned k = 0; k < fSlack.size(); k++) {
+      if (fSlack[k] < int(k)+1) {
+        next = oldest;
+        break;
+      }
+    }
+  }
+  for (int i = 0; i < n; i++) fAge[i]++;
+  fAge[next] = 0;
+  fCurrent = next;
+
+  auto now = std::chrono::steady_clock::now();
+  long wait = std::chrono::duration_cast<std::chrono::nanoseconds>(now - fLastRead[next]).count();
+  fLastRead[next] = now;
+  fRunMaxWait[next] = std::max(fRunMaxWait[next], wait);
+  long max = fMaxWait[next].load();
+  while (wait > max && !fMaxWait[next].compare_exchange_weak(max, wait)) {}
+  return fBoards[next];
+}
+
+void ReadScheduler::Done(int bytes) {
+  fScore[fCurrent] += kDecay*(bytes - fScore[fCurrent]);
+}
+
+void ReadScheduler::GetMaxWait(std::map<int, long>& ret) {
+  for (unsigned i = 0; i < fBoards.size(); i++)
+    if (long wait = fMaxWait[i].exchange(0); wait > 0) ret[fBoards[i]->bid()] = wait;
+}
+
+void ReadScheduler::GetRunMaxWait(std::map<int, long>& ret) {
+  for (unsigned i = 0; i < fBoards.size(); i++) ret[fBoards[i]->bid()] = fRunMaxWait[i];
+}
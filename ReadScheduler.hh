@@ -0,0 +1,56 @@
+#ifndef _READSCHEDULER_HH_
+#define _READSCHEDULER_HH_
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <vector>
+
+class Options;
+class V1724;
+
+class ReadScheduler{
+  /*
+    Which board of a link the readout thread reads next. Plain round robin
+    unless read_priority is set, in which case a board whose memory is full
+    goes first, and otherwise the one with the most data per read lately,
+    weighted by how many reads it has been waiting so boards with little data
+    still come up. Whenever that choice would make some board wait more than
+    read_max_skip reads of other boards, it's oldest first instead, so none
+    ever does. Also keeps track of the longest time each board went without
+    being read.
+  */
+
+public:
+  ReadScheduler(const std::vector<std::shared_ptr<V1724>>&, std::shared_ptr<Options>&);
+  ~ReadScheduler();
+
+  // Readout thread only, Next then Done with what the read gave
+  std::shared_ptr<V1724>& Next();
+  void Done(int bytes);
+  unsigned GetNumBoards() {return fBoards.size();}
+
+  // Any thread: {board: longest wait in ns} since the last call, boards that
+  // waited at all
+  void GetMaxWait(std::map<int, long>& ret);
+  // Once the readout thread is done: {board: longest wait in ns} this run
+  void GetRunMaxWait(std::map<int, long>& ret);
+
+  static constexpr double kDecay = 0.125; // weight of the newest read in the average
+  static constexpr double kFloor = 1024; // bytes, so waiting counts for empty boards too
+
+private:
+  std::vector<std::shared_ptr<V1724>> fBoards;
+  bool fPriority;
+  int fMaxSkip;
+  int fCurrent;
+  std::vector<double> fScore; // average bytes per read
+  std::vector<int> fAge; // reads of other boards since this one's
+  std::vector<int> fSlack;
+  std::vector<std::chrono::steady_clock::time_point> fLastRead;
+  std::unique_ptr<std::atomic_long[]> fMaxWait;
+  std::vector<long> fRunMaxWait;
+};
+
+#endif // _READSCHEDULER_HH_ defined
@@ -0,0 +1,118 @@
+#include "SampleScan.hh"
+#include <algorithm>
+#include <cstdlib>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+int SampleScan::Baseline(const uint16_t* wf, int n) {
+  return n > 0 ? Sum(wf, n)/n : 0;
+}
+
+long SampleScan::Sum(const uint16_t* wf, int n) {
+  long sum = 0;
+  int i = 0;
+#ifdef __SSE2__
+  // madd against 1 sums neighbouring pairs into 32 bits. Samples are unsigned
+  // and madd is signed, so they're shifted into signed range and back
+  const __m128i ones = _mm_set1_epi16(1), bias = _mm_set1_epi16(-32768);
+  alignas(16) int32_t parts[4];
+  while (i + 8 <= n) {
+    // 32 bits per lane is good for 2^15 iterations, so empty it before then
+    __m128i acc = _mm_setzero_si128();
+    for (int end = std::min(n - 7, i + (8<<14)); i < end; i += 8) {
+      __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(wf + i)), bias);
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(s, ones));
+    }
+    _mm_store_si128((__m128i*)parts, acc);
+    sum += long(parts[0]) + parts[1] + parts[2] + parts[3];
+  }
+  sum += 32768l*i;
+#endif
+  for (; i < n; i++) sum += wf[i];
+  return sum;
+}
+
+int SampleScan::Min(const uint16_t* wf, int n) {
+  int ret = 0xFFFF, i = 0;
+#ifdef __SSE2__
+  // SSE2 only has a signed 16-bit min, so flip the sign bits going in and out
+  if (n >= 8) {
+    const __m128i flip = _mm_set1_epi16(-32768);
+    __m128i m = _mm_set1_epi16(0x7FFF);
+    for (; i + 8 <= n; i += 8)
+      m = _mm_min_epi16(m, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(wf + i)), flip));
+    m = _mm_min_epi16(m, _mm_srli_si128(m, 8));
+    m = _mm_min_epi16(m, _mm_srli_si128(m, 4));
+    m = _mm_min_epi16(m, _mm_srli_si128(m, 2));
+    ret = uint16_t(_mm_cvtsi128_si32(m) ^ 0x8000);
+  }
+#endif
+  for (; i < n; i++) ret = std::min<int>(ret, wf[i]);
+  return ret;
+}
+
+int SampleScan::FindExcursions(const uint16_t* wf, int n, int baseline, int threshold,
+    std::vector<std::pair<int, int>>& ret, int polarity) {
+  int found = 0, start = -1, i = 0;
+  baseline = std::clamp(baseline, 0, 0xFFFF);
+  threshold = std::clamp(threshold, 0, 0x7FFF);
+  auto over = [&](int j) {
+    int d = int(wf[j]) - baseline;
+    return (polarity < 0 ? -d : polarity > 0 ? d : std::abs(d)) > threshold;
+  };
+#ifdef __SSE2__
+  // |sample - baseline| with saturating subtractions in both directions (or
+  // just the one we want), then one compare per 8 samples. Most blocks are all-quiet or all-loud, which
+  // is a single test of the mask; only blocks with an edge go sample by sample
+  const __m128i base = _mm_set1_epi16(uint16_t(baseline));
+  const __m128i thresh = _mm_set1_epi16(int16_t(threshold));
+  const __m128i flip = _mm_set1_epi16(-32768);
+  for (; i + 8 <= n; i += 8) {
+    __m128i s = _mm_loadu_si128((const __m128i*)(wf + i));
+    __m128i diff = polarity < 0 ? _mm_subs_epu16(base, s) : polarity > 0 ?
+      _mm_subs_epu16(s, base) : _mm_or_si128(_mm_subs_epu16(s, base), _mm_subs_epu16(base, s));
+    // unsigned compare by flipping the sign bits
+    __m128i loud = _mm_cmpgt_epi16(_mm_xor_si128(diff, flip), _mm_xor_si128(thresh, flip));
+    int mask = _mm_movemask_epi8(loud);
+    if (mask == 0 && start < 0) continue;
+    if (mask == 0xFFFF && start >= 0) continue;
+    for (int j = i; j < i + 8; j++) {
+      bool o = (mask >> (2*(j-i))) & 1;
+      if (o && start < 0) start = j;
+      else if (!o && start >= 0) {
+        ret.emplace_back(start, j);
+        start = -1;
+        found++;
+      }
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    bool o = over(i);
+    if (o && start < 0) start = i;
+    else if (!o && start >= 0) {
+      ret.emplace_back(start, i);
+      start = -1;
+      found++;
+    }
+  }
+  if (start >= 0) {
+    ret.emplace_back(start, n);
+    found++;
+  }
+  return found;
+}
+
+void SampleScan::Pad(std::vector<std::pair<int, int>>& runs, int pre, int post, int n) {
+  // runs come in order and don't overlap, so this is one pass
+  unsigned out = 0;
+  for (unsigned i = 0; i < runs.size(); i++) {
+    int start = std::max(0, runs[i].first - pre), end = std::min(n, runs[i].second + post);
+    if (out > 0 && start <= runs[out-1].second)
+      runs[out-1].second = std::max(runs[out-1].second, end);
+    else
+      runs[out++] = {start, end};
+  }
+  runs.resize(out);
+}
@@ -0,0 +1,31 @@
+#ifndef _SAMPLESCAN_HH_
+#define _SAMPLESCAN_HH_
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+class SampleScan{
+  /*
+    Vectorized loops over the 16-bit samples of one channel's waveform, for
+    the formatter stages that need to look at every sample (software ZLE,
+    hitfinder). Each has a scalar version that gives exactly the same answer
+  */
+
+public:
+  // Mean of the first n samples, rounded down
+  static int Baseline(const uint16_t* wf, int n);
+  static long Sum(const uint16_t* wf, int n);
+  // Smallest sample (0xFFFF if n is 0)
+  static int Min(const uint16_t* wf, int n);
+  // Appends [start, end) of every run of samples further than threshold from
+  // baseline to ret, returns how many runs there were. Polarity -1 only counts
+  // samples below the baseline, +1 only above, 0 either direction
+  static int FindExcursions(const uint16_t* wf, int n, int baseline, int threshold,
+      std::vector<std::pair<int, int>>& ret, int polarity=0);
+  // Widens each run by pre and post samples, clipped to [0, n), and merges
+  // runs that then overlap or touch
+  static void Pad(std::vector<std::pair<int, int>>& runs, int pre, int post, int n);
+};
+
+#endif // _SAMPLESCAN_HH_ defined
@@ -0,0 +1,121 @@
+#include "StraxCodec.hh"
+#include "WaveformFilter.hh"
+#include <lz4frame.h>
+#include <blosc.h>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+// Can tune here as needed, these are defaults from the LZ4 examples
+static const LZ4F_preferences_t kPrefs = {
+  { LZ4F_max256KB, LZ4F_blockLinked, LZ4F_noContentChecksum, LZ4F_frame, 0, { 0, 0 } },
+    0,   /* compression level; 0 == default */
+    0,   /* autoflush */
+    { 0, 0, 0 },  /* reserved, must be set to 0 */
+};
+static const uint32_t kLZ4FrameMagic = 0x184D2204;
+
+long StraxCodec::Compress(const std::string& codec, int level, const char* in, long bytes,
+    std::string& out) {
+  // codec is "lz4" or "blosc"
+  size_t start = out.size();
+  long max_compressed_size = 0, wsize = 0;
+  if(codec == "blosc"){
+    max_compressed_size = bytes + BLOSC_MAX_OVERHEAD;
+    out.resize(start + max_compressed_size);
+    wsize = blosc_compress_ctx(level < 0 ? 5 : level, 1, sizeof(char), bytes, in,
+        out.data() + start, max_compressed_size, "lz4", 0, 2);
+  }else{
+    // Note: the current package repo version for Ubuntu 18.04 (Oct 2019) is 1.7.1, which is
+    // so old it is not tracked on the lz4 github. The API for frame compression has changed
+    // just slightly in the meantime. So if you update and it breaks you'll have to tune at least
+    // the LZ4F_preferences_t object to the new format.
+    LZ4F_preferences_t prefs = kPrefs;
+    if (level >= 0) prefs.compressionLevel = level;
+    max_compressed_size = LZ4F_compressFrameBound(bytes, &prefs);
+    out.resize(start + max_compressed_size);
+    size_t ret = LZ4F_compressFrame(out.data() + start, max_compressed_size, in, bytes, &prefs);
+    wsize = LZ4F_isError(ret) ? -1 : long(ret);
+  }
+  out.resize(start + std::max(wsize, 0l));
+  return wsize;
+}
+
+std::string StraxCodec::Identify(const char* in, long bytes) {
+  uint32_t magic = 0;
+  if (bytes >= (long)sizeof(magic)) std::memcpy(&magic, in, sizeof(magic));
+  return magic == kLZ4FrameMagic ? "lz4" : "blosc";
+}
+
+long StraxCodec::Decompress(const char* in, long bytes, std::string& out) {
+  size_t start = out.size();
+  if (Identify(in, bytes) == "blosc") {
+    size_t nbytes(0), cbytes(0), blocksize(0);
+    blosc_cbuffer_sizes(in, &nbytes, &cbytes, &blocksize);
+    if ((long)cbytes > bytes) return -1;
+    out.resize(start + nbytes);
+    int ret = blosc_decompress_ctx(in, out.data() + start, nbytes, 1);
+    if (ret < 0) {
+      out.resize(start);
+      return -1;
+    }
+    return ret;
+  }
+  LZ4F_dctx* ctx = nullptr;
+  if (LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION))) return -1;
+  size_t src_pos = 0, out_pos = start, ret = 1;
+  // we don't know how big it'll be, so grow as needed
+  out.resize(start + 4*bytes + 1024);
+  while (src_pos < (size_t)bytes && ret != 0) {
+    if (out.size() - out_pos < 256*1024) out.resize(out.size()*2);
+    size_t dst_size = out.size() - out_pos, src_size = bytes - src_pos;
+    ret = LZ4F_decompress(ctx, out.data() + out_pos, &dst_size, in + src_pos, &src_size, nullptr);
+    if (LZ4F_isError(ret)) {
+      LZ4F_freeDecompressionContext(ctx);
+      out.resize(start);
+      return -1;
+    }
+    out_pos += dst_size;
+    src_pos += src_size;
+  }
+  LZ4F_freeDecompressionContext(ctx);
+  out.resize(out_pos);
+  return out_pos - start;
+}
+
+long StraxCodec::DecodeChunk(const char* in, long bytes, std::string& out) {
+  size_t start = out.size();
+  std::vector<std::pair<uint64_t, uint64_t>> blocks; // {offset, bytes}
+  block_trailer_t trailer;
+  if (bytes == 0) return 0;
+  if (bytes >= (long)sizeof(trailer))
+    std::memcpy(&trailer, in + bytes - sizeof(trailer), sizeof(trailer));
+  if (bytes >= (long)sizeof(trailer) && trailer.magic == block_trailer_t::kMagic) {
+    if (trailer.version != block_trailer_t::kVersion ||
+        trailer.index_offset + trailer.blocks*sizeof(block_index_t) + sizeof(trailer) != (uint64_t)bytes)
+      return -1;
+    std::vector<block_index_t> index(trailer.blocks);
+    std::memcpy(index.data(), in + trailer.index_offset, trailer.blocks*sizeof(block_index_t));
+    for (auto& b : index) {
+      if (b.offset + b.compressed_bytes > trailer.index_offset) return -1;
+      blocks.emplace_back(b.offset, b.compressed_bytes);
+    }
+  } else {
+    blocks.emplace_back(0, bytes);
+  }
+  std::string block;
+  for (auto& [offset, size] : blocks) {
+    block.clear();
+    bool ok = Decompress(in + offset, size, block) >= 0;
+    if (ok && WaveformFilter::IsFiltered(block.data(), block.size()))
+      ok = WaveformFilter::Decode(block.data(), block.size(), out) >= 0;
+    else if (ok)
+      out += block;
+    if (!ok) {
+      out.resize(start);
+      return -1;
+    }
+  }
+  return out.size() - start;
+}
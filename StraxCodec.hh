@@ -0,0 +1,45 @@
+#ifndef _STRAXCODEC_HH_
+#define _STRAXCODEC_HH_
+
+#include <cstdint>
+#include <string>
+
+// For the grouped chunk layout: [block][block]...[block_index_t x N][block_trailer_t]
+struct block_index_t{
+  int32_t first_channel;
+  int32_t last_channel;
+  uint64_t offset; // from the start of the file
+  uint64_t compressed_bytes;
+  uint64_t uncompressed_bytes;
+  uint32_t fragments;
+  uint32_t reserved;
+};
+
+struct block_trailer_t{
+  uint64_t index_offset;
+  uint32_t blocks;
+  uint32_t version;
+  uint64_t magic;
+  static const uint32_t kVersion = 1;
+  static const uint64_t kMagic = 0x5244584944584B43; // "RDXIDXKC"
+};
+
+class StraxCodec{
+  /*
+    The compressors used for strax chunks, in one place so the formatter and
+    the offline tools agree on the settings
+  */
+
+public:
+  // Appends the compressed data to out, returns how many bytes that was (<0 for failure).
+  // level <0 is the codec's own default
+  static long Compress(const std::string& codec, int level, const char* in, long bytes,
+      std::string& out);
+  // Appends the decompressed data to out. Works out the codec from the data
+  static long Decompress(const char* in, long bytes, std::string& out);
+  static std::string Identify(const char* in, long bytes);
+  // Appends the fragments of a whole chunk file to out, whatever its layout or prefilter
+  static long DecodeChunk(const char* in, long bytes, std::string& out);
+};
+
+#endif // _STRAXCODEC_HH_ defined
@@ -3,36 +3,59 @@
 #include "MongoLog.hh"
 #include "Options.hh"
 #include "V1724.hh"
-#include <lz4frame.h>
-#include <blosc.h>
+#include "DigitizerFormats.hh"
+#include "LiveDataRing.hh"
+#include "ChunkStreamer.hh"
+#include "StraxCodec.hh"
+#include "WaveformFilter.hh"
+#include "SampleScan.hh"
+#include "CoincidenceFilter.hh"
+#include "ChannelPrescaler.hh"
+#include "MetricsRegistry.hh"
 #include <thread>
 #include <sstream>
 #include <bitset>
 #include <ctime>
 #include <cmath>
+#include <climits>
+
+#include <bsoncxx/builder/stream/document.hpp>
+#include <bsoncxx/json.hpp>
 
 namespace fs=std::experimental::filesystem;
 using namespace std::chrono;
 const int event_header_words = 4, max_channels = 16;
 
-double timespec_subtract(struct timespec& a, struct timespec& b) {
-  return (a.tv_sec - b.tv_sec)*1e6 + (a.tv_nsec - b.tv_nsec)/1e3;
-}
-
-StraxFormatter::StraxFormatter(std::shared_ptr<Options>& opts, std::shared_ptr<MongoLog>& log){
+StraxFormatter::StraxFormatter(std::shared_ptr<Options>& opts, std::shared_ptr<MongoLog>& log,
+    std::shared_ptr<LiveDataRing>& ring, std::shared_ptr<ChunkStreamer>& streamer,
+    std::shared_ptr<CoincidenceFilter>& coincidence, std::shared_ptr<ChannelPrescaler>& prescaler,
+    std::shared_ptr<MetricsRegistry>& metrics){
   fActive = true;
   fChunkNameLength=6;
   fStraxHeaderSize=24;
   fBytesProcessed = 0;
   fInputBufferSize = 0;
   fOutputBufferSize = 0;
-  fProcTimeDP = fProcTimeEv = fProcTimeCh = fCompTime = 0.;
+  fChunksLost = 0;
   fOptions = opts;
   fChunkLength = long(fOptions->GetDouble("strax_chunk_length", 5)*1e9); // default 5s
   fChunkOverlap = long(fOptions->GetDouble("strax_chunk_overlap", 0.5)*1e9); // default 0.5s
   fFragmentBytes = fOptions->GetInt("strax_fragment_payload_bytes", 110*2);
   fFullFragmentSize = fFragmentBytes + fStraxHeaderSize;
   fCompressor = fOptions->GetString("compressor", "lz4");
+  fCompressionLevel = fOptions->GetInt("compression_level", -1);
+  fPrefilter = fOptions->GetString("strax_prefilter", "none");
+  fWriteMetadata = fOptions->GetInt("strax_chunk_metadata", 0) != 0;
+  fChannelsPerBlock = 0;
+  fZLE = fOptions->GetInt("software_zle", 0) != 0;
+  fZLEThreshold = fOptions->GetInt("zle_threshold", 20);
+  fZLEPre = std::max(0, fOptions->GetInt("zle_pre_samples", 50));
+  fZLEPost = std::max(0, fOptions->GetInt("zle_post_samples", 50));
+  fBaselineSamples = std::max(1, fOptions->GetInt("software_baseline_samples", 16));
+  fHitfinder = fOptions->GetInt("hitfinder", 0) != 0;
+  fHitThreshold = fOptions->GetInt("hit_threshold", 15);
+  if (fOptions->GetString("strax_chunk_layout", "interleaved") == "grouped")
+    fChannelsPerBlock = std::max(1, fOptions->GetInt("strax_channels_per_block", 8));
   fFullChunkLength = fChunkLength+fChunkOverlap;
   fHostname = fOptions->Hostname();
   std::string run_name;
@@ -47,6 +70,15 @@ StraxFormatter::StraxFormatter(std::shared_ptr<Options>& opts, std::shared_ptr<M
 
   fEmptyVerified = 0;
   fLog = log;
+  fLiveRing = ring;
+  fStreamer = streamer;
+  fCoincidence = coincidence;
+  fCoincidenceID = fCoincidence ? fCoincidence->Register() : -1;
+  fPrescaler = prescaler;
+  fMetrics = metrics;
+  fSlot = fMetrics->Register();
+  fCounting = fMetrics->Counting();
+  fTiming = fMetrics->Timing();
 
   fBufferNumChunks = fOptions->GetInt("strax_buffer_num_chunks", 2);
   fWarnIfChunkOlderThan = fOptions->GetInt("strax_chunk_phase_limit", 2);
@@ -57,6 +89,10 @@ StraxFormatter::StraxFormatter(std::shared_ptr<Options>& opts, std::shared_ptr<M
     op /= run_name;
     fOutputPath = op;
     fs::create_directory(op);
+    if (fHitfinder) {
+      fHitsPath = op.string() + "_hits";
+      fs::create_directory(fHitsPath);
+    }
   }
   catch(...){
     fLog->Entry(MongoLog::Error, "StraxFormatter::Initialize tried to create output directory but failed. Check that you have permission to write here.");
@@ -65,21 +101,7 @@ StraxFormatter::StraxFormatter(std::shared_ptr<Options>& opts, std::shared_ptr<M
 }
 
 StraxFormatter::~StraxFormatter(){
-  std::stringstream ss;
-  ss << std::hex << fThreadId;
-  std::map<std::string, double> times {
-    {"data_packets_us", fProcTimeDP},
-    {"events_us", fProcTimeEv},
-    {"fragments_us", fProcTimeCh},
-    {"compression_us", fCompTime}
-  };
-  std::map<std::string, std::map<int, long>> counters {
-    {"fragments", fFragsPerEvent},
-    {"events", fEvPerDP},
-    {"data_packets", fBufferCounter},
-    {"chunks", fBytesPerChunk}
-  };
-  //fOptions->SaveBenchmarks(counters, fBytesProcessed, ss.str(), times);
+  fSlot = nullptr; // belongs to the registry
 }
 
 void StraxFormatter::Close(std::map<int,int>& ret){
@@ -88,129 +110,225 @@ void StraxFormatter::Close(std::map<int,int>& ret){
   fCV.notify_one();
 }
 
-void StraxFormatter::GetDataPerChan(std::map<int, int>& ret) {
-  if (!fActive) return;
-  const std::lock_guard<std::mutex> lk(fDPC_mutex);
-  for (auto& pair : fDataPerChan) {
-    ret[pair.first] += pair.second;
-    pair.second = 0;
+void StraxFormatter::GetZLEStats(std::map<int, std::pair<long, long>>& ret) {
+  // only call this once the processing thread is done
+  for (auto& [ch, stats] : fZLEStats) {
+    ret[ch].first += stats.first;
+    ret[ch].second += stats.second;
   }
-  return;
 }
 
-void StraxFormatter::GenerateArtificialDeadtime(int64_t timestamp, const std::shared_ptr<V1724>& digi) {
-  std::string fragment;
-  fragment.reserve(fFullFragmentSize);
-  timestamp *= digi->GetClockWidth(); // TODO nv
-  int32_t length = fFragmentBytes>>1;
-  int16_t sw = digi->SampleWidth(), channel = digi->GetADChannel(), zero = 0;
-  fragment.append((char*)&timestamp, sizeof(timestamp));
-  fragment.append((char*)&length, sizeof(length));
-  fragment.append((char*)&sw, sizeof(sw));
-  fragment.append((char*)&channel, sizeof(channel));
-  fragment.append((char*)&length, sizeof(length));
-  fragment.append((char*)&zero, sizeof(zero)); // fragment_i
-  fragment.append((char*)&zero, sizeof(zero)); // baseline
-  for (; length > 0; length--)
-    fragment.append((char*)&zero, sizeof(zero)); // wf
-  AddFragmentToBuffer(std::move(fragment), 0, 0);
-  return;
+void StraxFormatter::GenerateArtificialDeadtime(int64_t start, int64_t end,
+    const std::shared_ptr<V1724>& digi) {
+  // Zeros on the board's deadtime channel covering [start, end) ns. dt gets
+  // stretched so one record covers as much as it can, so even long intervals
+  // only take a few
+  const int samples_per_frag = fFragmentBytes>>1;
+  int16_t channel = digi->GetADChannel(), zero = 0;
+  fADChannels.insert(channel);
+  while (start < end) {
+    int16_t dt = std::clamp<int64_t>((end - start + samples_per_frag - 1)/samples_per_frag,
+        digi->SampleWidth(), INT16_MAX);
+    int32_t length = std::min<int64_t>(samples_per_frag, (end - start + dt - 1)/dt);
+    std::string fragment;
+    fragment.reserve(fFullFragmentSize);
+    fragment.append((char*)&start, sizeof(start));
+    fragment.append((char*)&length, sizeof(length));
+    fragment.append((char*)&dt, sizeof(dt));
+    fragment.append((char*)&channel, sizeof(channel));
+    fragment.append((char*)&length, sizeof(length));
+    fragment.append((char*)&zero, sizeof(zero)); // fragment_i
+    fragment.append((char*)&zero, sizeof(zero)); // baseline
+    for (int i = 0; i < samples_per_frag; i++)
+      fragment.append((char*)&zero, sizeof(zero)); // wf
+    AddFragmentToBuffer(std::move(fragment), start/digi->GetClockWidth());
+    start += int64_t(length)*dt;
+  }
 }
 
 void StraxFormatter::ProcessDatapacket(std::unique_ptr<data_packet> dp){
+  for (auto& [start, end] : dp->deadtime) GenerateArtificialDeadtime(start, end, dp->digi);
+  // Pick the decoder once per packet, everything below is specialized for the board type
+  switch (dp->digi->GetFormat()) {
+    case DigitizerFormats::kV1724:
+      ProcessPacket(std::move(dp), DigitizerFormats::V1724Format{});
+      break;
+    case DigitizerFormats::kV1730:
+      ProcessPacket(std::move(dp), DigitizerFormats::V1730Format{});
+      break;
+    case DigitizerFormats::kV1724_MV:
+      ProcessPacket(std::move(dp), DigitizerFormats::V1724MVFormat{});
+      break;
+    default: {
+      DigitizerFormats::GenericFormat<V1724> fmt(dp->digi.get());
+      ProcessPacket(std::move(dp), fmt);
+    }
+  }
+}
+
+std::vector<int16_t>& StraxFormatter::GetChannelMap(const std::shared_ptr<V1724>& digi) {
+  // {board channel: global channel}, so the options only get asked once per channel.
+  // -2 means we haven't asked yet
+  auto it = fChannelMap.find(digi->bid());
+  if (it == fChannelMap.end())
+    it = fChannelMap.emplace(digi->bid(), std::vector<int16_t>(
+          std::max<unsigned>(max_channels, digi->GetNumChannels()), -2)).first;
+  return it->second;
+}
+
+template<typename Format>
+void StraxFormatter::ProcessPacket(std::unique_ptr<data_packet> dp, const Format& fmt) {
   // Take a buffer and break it up into one document per channel
-  struct timespec dp_start, dp_end, ev_start, ev_end;
-  auto it = dp->buff.begin();
+  CpuTimer dp_timer(fSlot, MetricsRegistry::kPacketTime, fTiming);
+  std::vector<int16_t>& chmap = GetChannelMap(dp->digi);
+  const char32_t* buff = dp->buff.data();
+  size_t n = dp->buff.size(), idx = 0, skipped = 0;
   int evs_this_dp(0), words(0);
-  bool missed = false;
-  std::map<int, int> dpc;
-  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &dp_start);
-  do {
-    if((*it)>>28 == 0xA){
-      missed = true; // it works out
-      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ev_start);
-      words = (*it)&0xFFFFFFF;
-      std::u32string_view sv(dp->buff.data() + std::distance(dp->buff.begin(), it), words);
-      // std::u32string_view sv(it, it+words); //c++20 :(
-      ProcessEvent(sv, dp, dpc);
-      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ev_end);
-      fProcTimeEv += timespec_subtract(ev_end, ev_start);
-      evs_this_dp++;
-      it += words;
-    } else {
-      if (missed) {
+  // the readout already found the events, anything in between them is
+  // something we lost sync on
+  for (size_t i = 0; i < dp->events.size() && fActive == true; i++) {
+    if (dp->events[i] != idx) {
+      if (skipped == 0)
         fLog->Entry(MongoLog::Warning, "Missed an event from %i at idx %x/%x (%x)",
-            dp->digi->bid(), std::distance(dp->buff.begin(), it), dp->buff.size(), *it);
-        missed = false;
-      }
-      it++;
+            dp->digi->bid(), idx, n, buff[idx]);
+      skipped += dp->events[i] - idx;
+      idx = dp->events[i];
+    }
+    words = buff[idx]&0xFFFFFFF;
+    std::u32string_view sv(buff + idx, words);
+    {
+      CpuTimer ev_timer(fSlot, MetricsRegistry::kEventTime, fTiming);
+      ProcessEvent(sv, dp->times[i], dp, chmap, fmt);
     }
-  } while (it < dp->buff.end() && fActive == true);
-  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &dp_end);
-  fProcTimeDP += timespec_subtract(dp_end, dp_start);
+    evs_this_dp++;
+    idx += words;
+  }
+  if (idx < n && fActive == true) skipped += n - idx;
+  if (skipped > 0) {
+    dp->digi->AddSkippedWords(skipped);
+    if (fCounting) fSlot->Add(MetricsRegistry::kSkippedWords, skipped);
+  }
   fBytesProcessed += dp->buff.size()*sizeof(char32_t);
-  fEvPerDP[evs_this_dp]++;
-  {
-    const std::lock_guard<std::mutex> lk(fDPC_mutex);
-    for (auto& p : dpc) fDataPerChan[p.first] += p.second;
+  if (fCounting) {
+    fSlot->Add(MetricsRegistry::kBytesProcessed, dp->buff.size()*sizeof(char32_t));
+    fSlot->Add(MetricsRegistry::kDataPackets, 1);
+    fSlot->Add(MetricsRegistry::kEvents, evs_this_dp);
+    fSlot->Fill(MetricsRegistry::kEventsPerPacket, evs_this_dp);
   }
   fInputBufferSize -= dp->buff.size()*sizeof(char32_t);
 }
 
-int StraxFormatter::ProcessEvent(std::u32string_view buff,
-    const std::unique_ptr<data_packet>& dp, std::map<int, int>& dpc) {
-  // buff = start of event
-
-  struct timespec ch_start, ch_end;
+template<typename Format>
+int StraxFormatter::ProcessEvent(std::u32string_view buff, int64_t event_time,
+    const std::unique_ptr<data_packet>& dp, std::vector<int16_t>& chmap, const Format& fmt) {
+  // buff = start of event, event_time in clock cycles
 
-  // returns {words this event, channel mask, board fail, header timestamp}
-  auto [words, channel_mask, fail, event_time] = dp->digi->UnpackEventHeader(buff);
+  auto header = fmt.EventHeader(buff);
 
-  if(fail){ // board fail
-    //GenerateArtificialDeadtime(((dp->clock_counter<<31) + dp->header_time), dp->digi);
+  if(header.fail){ // board fail
+    // no deadtime record here, how long the board was out shows up in its busy bit
+    // (V1724::TrackBusy)
     dp->digi->CheckFail(true);
     fFailCounter[dp->digi->bid()]++;
+    if (fCounting) fSlot->Add(MetricsRegistry::kBoardFails, 1);
     return event_header_words;
   }
 
   buff.remove_prefix(event_header_words);
-  int ret;
   int frags(0);
-  unsigned n_chan = dp->digi->GetNumChannels();
-
-  for(unsigned ch=0; ch<n_chan; ch++){
-    if (channel_mask & (1<<ch)) {
-      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ch_start);
-      ret = ProcessChannel(buff, words, channel_mask, event_time, frags, ch, dp, dpc);
-      clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ch_end);
-      fProcTimeCh += timespec_subtract(ch_end, ch_start);
-      buff.remove_prefix(ret);
+  int n_channels = std::bitset<max_channels>(header.channel_mask).count();
+  uint16_t sw = fmt.SampleWidth();
+
+  for(unsigned ch=0; ch<fmt.Channels(); ch++){
+    if (header.channel_mask & (1<<ch)) {
+      CpuTimer ch_timer(fSlot, MetricsRegistry::kChannelTime, fTiming);
+      auto channel = fmt.ChannelHeader(buff, event_time, header.words, n_channels);
+      if (chmap[ch] == -2) chmap[ch] = fOptions->GetChannel(dp->digi->bid(), ch);
+      int16_t global_ch = chmap[ch];
+      // Failing to discern which channel we're getting data from seems serious enough to throw
+      if(global_ch==-1)
+        throw std::runtime_error("Failed to parse channel map. I'm gonna just kms now.");
+      ProcessChannel((const uint16_t*)channel.wf.data(),
+          channel.wf.size()*sizeof(char32_t)/sizeof(uint16_t), channel.timestamp, sw,
+          global_ch, channel.baseline, event_time, frags);
+      buff.remove_prefix(channel.words);
     }
   }
-  fFragsPerEvent[frags]++;
-  return words;
+  if (fCounting) {
+    fSlot->Add(MetricsRegistry::kFragments, frags);
+    fSlot->Fill(MetricsRegistry::kFragmentsPerEvent, frags);
+  }
+  return header.words;
 }
 
-int StraxFormatter::ProcessChannel(std::u32string_view buff, int words_in_event,
-    int channel_mask, uint32_t event_time, int& frags, int channel,
-    const std::unique_ptr<data_packet>& dp, std::map<int, int>& dpc) {
-  // buff points to the first word of the channel's data
+void StraxFormatter::ProcessChannel(const uint16_t* samples, uint32_t samples_in_pulse,
+    int64_t timestamp, uint16_t sw, int16_t global_ch, uint16_t baseline_ch, int64_t event_time,
+    int& frags) {
+  // Everything after the channel header, which doesn't depend on the board type
 
-  int n_channels = std::bitset<max_channels>(channel_mask).count();
-  // returns {timestamp (ns), words this channel, baseline, waveform}
-  auto [timestamp, channel_words, baseline_ch, wf] = dp->digi->UnpackChannelHeader(
-      buff, dp->clock_counter, dp->header_time, event_time, words_in_event, n_channels);
+  // counted before the prescale so the rates reflect what the channel is doing
+  fSlot->AddChannel(global_ch, samples_in_pulse*sizeof(uint16_t));
+  if (int factor = fPrescaler ? fPrescaler->Factor(global_ch) : 1; factor != 1) {
+    if (factor == 0 || fPrescaleCounter[global_ch]++ % factor != 0)
+      return;
+  }
 
-  uint32_t samples_in_pulse = wf.size()*sizeof(char32_t)/sizeof(uint16_t);
-  uint16_t sw = dp->digi->SampleWidth();
-  int samples_per_frag= fFragmentBytes>>1;
-  int16_t global_ch = fOptions->GetChannel(dp->digi->bid(), channel);
-  // Failing to discern which channel we're getting data from seems serious enough to throw
-  if(global_ch==-1)
-    throw std::runtime_error("Failed to parse channel map. I'm gonna just kms now.");
+  int baseline = 0;
+  if (fZLE || fHitfinder)
+    baseline = SampleScan::Baseline(samples, std::min<int>(fBaselineSamples, samples_in_pulse));
+  if (fHitfinder)
+    FindHits(samples, samples_in_pulse, baseline, timestamp, sw, global_ch);
+  if (fZLE) {
+    // Only the parts of the waveform that leave the baseline (plus some
+    // context) become pulses. Each is a pulse of its own as far as strax is
+    // concerned, so they start over at record_i = 0
+    fZLERuns.clear();
+    SampleScan::FindExcursions(samples, samples_in_pulse, baseline, fZLEThreshold, fZLERuns);
+    SampleScan::Pad(fZLERuns, fZLEPre, fZLEPost, samples_in_pulse);
+    long kept = 0;
+    for (auto& [start, end] : fZLERuns) {
+      frags += EmitPulse(samples + start, end - start, timestamp + int64_t(start)*sw, sw, global_ch,
+          baseline_ch, event_time);
+      kept += end - start;
+    }
+    auto& stats = fZLEStats[global_ch];
+    stats.first += samples_in_pulse;
+    stats.second += kept;
+  } else {
+    frags += EmitPulse(samples, samples_in_pulse, timestamp, sw, global_ch, baseline_ch,
+        event_time);
+  }
+}
 
+void StraxFormatter::FindHits(const uint16_t* samples, uint32_t samples_in_pulse, int baseline,
+    int64_t timestamp, uint16_t sw, int16_t global_ch) {
+  // Hits are runs of samples more than the channel's threshold below the
+  // baseline (our pulses are negative), the same thing strax's hitfinder does first
+  auto it = fHitThresholds.find(global_ch);
+  if (it == fHitThresholds.end())
+    it = fHitThresholds.emplace(global_ch, fOptions->GetNestedInt("hit_thresholds." +
+          std::to_string(global_ch), fHitThreshold)).first;
+  fHitRuns.clear();
+  SampleScan::FindExcursions(samples, samples_in_pulse, baseline, it->second, fHitRuns, -1);
+  hit_t hit;
+  hit.dt = sw;
+  hit.channel = global_ch;
+  hit.reserved = 0;
+  for (auto& [start, end] : fHitRuns) {
+    hit.time = timestamp + int64_t(start)*sw;
+    hit.length = end - start;
+    hit.area = float(long(baseline)*hit.length - SampleScan::Sum(samples + start, hit.length));
+    hit.height = baseline - SampleScan::Min(samples + start, hit.length);
+    auto [chunk_id, overlap] = GetChunk(hit.time);
+    (overlap ? fHitOverlaps : fHitChunks)[chunk_id].append((const char*)&hit, sizeof(hit));
+  }
+}
+
+int StraxFormatter::EmitPulse(const uint16_t* samples, uint32_t samples_in_pulse, int64_t timestamp,
+    uint16_t sw, int16_t global_ch, uint16_t baseline_ch, int64_t event_time) {
+  // Splits one pulse into fragments, returns how many
+  int samples_per_frag= fFragmentBytes>>1;
   int num_frags = std::ceil(1.*samples_in_pulse/samples_per_frag);
-  frags += num_frags;
   int32_t samples_this_frag = 0;
   int64_t time_this_frag = 0;
   const uint16_t zero_filler = 0;
@@ -233,22 +351,26 @@ int StraxFormatter::ProcessChannel(std::u32string_view buff, int words_in_event,
     fragment.append((char*)&baseline_ch, sizeof(baseline_ch));
 
     // Copy the raw buffer
-    fragment.append((char*)wf.data(), samples_this_frag*sizeof(uint16_t));
-    wf.remove_prefix(samples_this_frag*sizeof(uint16_t)/sizeof(char32_t));
+    fragment.append((const char*)samples, samples_this_frag*sizeof(uint16_t));
+    samples += samples_this_frag;
     for (; samples_this_frag < samples_per_frag; samples_this_frag++)
       fragment.append((char*)&zero_filler, sizeof(zero_filler));
 
-    AddFragmentToBuffer(std::move(fragment), event_time, dp->clock_counter);
+    AddFragmentToBuffer(std::move(fragment), event_time);
   } // loop over frag_i
-  dpc[global_ch] += samples_in_pulse*sizeof(uint16_t);
-  return channel_words;
+  return num_frags;
+}
+
+std::pair<int, bool> StraxFormatter::GetChunk(int64_t timestamp) {
+  // {chunk, whether it's in the overlap at the end of that chunk}
+  int chunk_id = timestamp/fFullChunkLength;
+  return {chunk_id, (chunk_id+1)* fFullChunkLength - timestamp <= fChunkOverlap};
 }
 
-void StraxFormatter::AddFragmentToBuffer(std::string fragment, uint32_t ts, int rollovers) {
+void StraxFormatter::AddFragmentToBuffer(std::string fragment, int64_t event_time) {
   // Get the CHUNK and decide if this event also goes into a PRE/POST file
   int64_t timestamp = *(int64_t*)fragment.data();
-  int chunk_id = timestamp/fFullChunkLength;
-  bool overlap = (chunk_id+1)* fFullChunkLength - timestamp <= fChunkOverlap;
+  auto [chunk_id, overlap] = GetChunk(timestamp);
   int min_chunk(0), max_chunk(1);
   if (fChunks.size() > 0) {
     auto [min_iter, max_iter] = std::minmax_element(fChunks.begin(), fChunks.end(), 
@@ -260,14 +382,24 @@ void StraxFormatter::AddFragmentToBuffer(std::string fragment, uint32_t ts, int
   const short* channel = (const short*)(fragment.data()+14);
   if (min_chunk - chunk_id > fWarnIfChunkOlderThan) {
     fLog->Entry(MongoLog::Warning,
-        "Thread %lx got data from ch %i that's in chunk %i instead of %i/%i (ts %lx), it might get lost (ts %lx ro %i)",
-        fThreadId, *channel, chunk_id, min_chunk, max_chunk, timestamp, ts, rollovers);
+        "Thread %lx got data from ch %i that's in chunk %i instead of %i/%i (ts %lx), it might get lost (event %lx)",
+        fThreadId, *channel, chunk_id, min_chunk, max_chunk, timestamp, event_time);
   } else if (chunk_id - max_chunk > 1) {
     fLog->Entry(MongoLog::Message, "Thread %lx skipped %i chunk(s) (ch%i)",
         fThreadId, chunk_id - max_chunk - 1, *channel);
   }
 
   fOutputBufferSize += fFullFragmentSize;
+  // local consumers get to see this now, rather than once the chunk is written
+  if (fLiveRing) fLiveRing->Publish(fragment.data(), fragment.size());
+
+  if (fWriteMetadata) {
+    // {time, length, dt, channel} are the first fields of the strax header
+    int64_t end = timestamp + int64_t(*(const int32_t*)(fragment.data()+8)) *
+      *(const int16_t*)(fragment.data()+12);
+    (overlap ? fOverlapStats : fChunkStats)[chunk_id].Add(timestamp, end, *channel,
+        fragment.size());
+  }
 
   if(!overlap){
     fChunks[chunk_id].emplace_back(std::move(fragment));
@@ -279,7 +411,8 @@ void StraxFormatter::AddFragmentToBuffer(std::string fragment, uint32_t ts, int
 void StraxFormatter::ReceiveDatapackets(std::list<std::unique_ptr<data_packet>>& in, int bytes) {
   {
     const std::lock_guard<std::mutex> lk(fBufferMutex);
-    fBufferCounter[in.size()]++;
+    // the lock makes this thread the only writer for the moment
+    if (fCounting) fSlot->Fill(MetricsRegistry::kPacketsPerTransfer, in.size());
     fBuffer.splice(fBuffer.end(), in);
     fInputBufferSize += bytes;
   }
@@ -301,6 +434,7 @@ void StraxFormatter::Process() {
       dp = std::move(fBuffer.front());
       fBuffer.pop_front();
       lk.unlock();
+      if (fCoincidence) fCoincidence->Active(fCoincidenceID);
       ProcessDatapacket(std::move(dp));
       if (fActive == true) WriteOutChunks();
     } else {
@@ -309,57 +443,116 @@ void StraxFormatter::Process() {
   }
   if (fBytesProcessed > 0)
     End();
+  if (fCoincidence) fCoincidence->Finish(fCoincidenceID);
 }
 
-// Can tune here as needed, these are defaults from the LZ4 examples
-static const LZ4F_preferences_t kPrefs = {
-  { LZ4F_max256KB, LZ4F_blockLinked, LZ4F_noContentChecksum, LZ4F_frame, 0, { 0, 0 } },
-    0,   /* compression level; 0 == default */
-    0,   /* autoflush */
-    { 0, 0, 0 },  /* reserved, must be set to 0 */
-};
+long StraxFormatter::Compress(const std::string& uncompressed, std::string& out) {
+  // Appends the compressed data to out, returns how many bytes that was
+  long wsize = -1;
+  if (fPrefilter == "delta_shuffle") {
+    // readers recognize the filtered blocks by their header, so if this doesn't
+    // work out we can still store this block unfiltered
+    std::string filtered;
+    if (WaveformFilter::Encode(uncompressed.data(), uncompressed.size(), fFullFragmentSize,
+          filtered) >= 0)
+      wsize = StraxCodec::Compress(fCompressor, fCompressionLevel, filtered.data(),
+          filtered.size(), out);
+    else
+      fLog->Entry(MongoLog::Warning, "Thread %lx couldn't prefilter %li bytes",
+          fThreadId, uncompressed.size());
+  }
+  if (wsize < 0)
+    wsize = StraxCodec::Compress(fCompressor, fCompressionLevel, uncompressed.data(),
+        uncompressed.size(), out);
+  if (wsize < 0)
+    fLog->Entry(MongoLog::Error, "Thread %lx failed to compress %li bytes with %s",
+        fThreadId, uncompressed.size(), fCompressor.c_str());
+  return wsize;
+}
+
+long StraxFormatter::CompressGrouped(std::list<std::string>& fragments, std::string& out) {
+  // Sorts the fragments into blocks of channels, each block compressed on its
+  // own, followed by an index saying where each block is. Readers can then
+  // decompress only the channels they care about. Fragments are spliced
+  // between lists, not copied, until they're concatenated for the compressor
+  std::map<int, std::list<std::string>> blocks;
+  while (fragments.size() > 0) {
+    int16_t channel = *(const int16_t*)(fragments.front().data()+14);
+    auto& block = blocks[channel/fChannelsPerBlock];
+    block.splice(block.end(), fragments, fragments.begin());
+  }
+  std::vector<block_index_t> index;
+  index.reserve(blocks.size());
+  std::string uncompressed;
+  for (auto& [block_i, frags] : blocks) {
+    block_index_t entry;
+    entry.first_channel = block_i*fChannelsPerBlock;
+    entry.last_channel = entry.first_channel + fChannelsPerBlock - 1;
+    entry.offset = out.size();
+    entry.fragments = frags.size();
+    entry.reserved = 0;
+    uncompressed.reserve(frags.size()*fFullFragmentSize);
+    for (auto& frag : frags) uncompressed += frag;
+    entry.uncompressed_bytes = uncompressed.size();
+    long wsize = Compress(uncompressed, out);
+    if (wsize < 0) return -1; // one missing block and the index is no good
+    entry.compressed_bytes = wsize;
+    uncompressed.clear();
+    index.push_back(entry);
+  }
+  block_trailer_t trailer;
+  trailer.index_offset = out.size();
+  trailer.blocks = index.size();
+  trailer.version = block_trailer_t::kVersion;
+  trailer.magic = block_trailer_t::kMagic;
+  out.append((const char*)index.data(), index.size()*sizeof(block_index_t));
+  out.append((const char*)&trailer, sizeof(trailer));
+  return out.size();
+}
 
 void StraxFormatter::WriteOutChunk(int chunk_i){
   // Write the contents of the buffers to compressed files
-  struct timespec comp_start, comp_end;
-  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &comp_start);
+  CpuTimer timer(fSlot, MetricsRegistry::kChunkTime, fTiming);
 
+  if (fCoincidence) ApplyCoincidence(chunk_i);
   std::vector<std::list<std::string>*> buffers{{&fChunks[chunk_i], &fOverlaps[chunk_i]}};
   std::vector<long> uncompressed_size(3, 0);
   std::string uncompressed;
   std::vector<std::shared_ptr<std::string>> out_buffer(3);
   std::vector<int> wsize(3);
-  long max_compressed_size = 0;
 
   for (int i = 0; i < 2; i++) {
     if (buffers[i]->size() == 0) continue;
     uncompressed_size[i] = buffers[i]->size()*fFullFragmentSize;
-    uncompressed.reserve(uncompressed_size[i]);
-    for (auto it = buffers[i]->begin(); it != buffers[i]->end(); it++)
-      uncompressed += *it; // std::accumulate would be nice but 3x slower without -O2
-    // (also only works on c++20 because std::move, but still)
+    out_buffer[i] = std::make_shared<std::string>();
+    if (fChannelsPerBlock > 0) {
+      wsize[i] = CompressGrouped(*buffers[i], *out_buffer[i]);
+    } else {
+      uncompressed.reserve(uncompressed_size[i]);
+      for (auto it = buffers[i]->begin(); it != buffers[i]->end(); it++)
+        uncompressed += *it; // std::accumulate would be nice but 3x slower without -O2
+      // (also only works on c++20 because std::move, but still)
+      wsize[i] = Compress(uncompressed, *out_buffer[i]);
+      uncompressed.clear();
+    }
     buffers[i]->clear();
-    if(fCompressor == "blosc"){
-      max_compressed_size = uncompressed_size[i] + BLOSC_MAX_OVERHEAD;
-      out_buffer[i] = std::make_shared<std::string>(max_compressed_size, 0);
-      wsize[i] = blosc_compress_ctx(5, 1, sizeof(char), uncompressed_size[i],
-          uncompressed.data(), out_buffer[i]->data(), max_compressed_size,"lz4", 0, 2);
-    }else{
-      // Note: the current package repo version for Ubuntu 18.04 (Oct 2019) is 1.7.1, which is
-      // so old it is not tracked on the lz4 github. The API for frame compression has changed
-      // just slightly in the meantime. So if you update and it breaks you'll have to tune at least
-      // the LZ4F_preferences_t object to the new format.
-      max_compressed_size = LZ4F_compressFrameBound(uncompressed_size[i], &kPrefs);
-      out_buffer[i] = std::make_shared<std::string>(max_compressed_size, 0);
-      wsize[i] = LZ4F_compressFrame(out_buffer[i]->data(), max_compressed_size,
-          uncompressed.data(), uncompressed_size[i], &kPrefs);
+    if (fCounting) {
+      fSlot->Add(MetricsRegistry::kChunks, 1);
+      fSlot->Add(MetricsRegistry::kChunkBytes, uncompressed_size[i]);
+      fSlot->Add(MetricsRegistry::kCompressedBytes, std::max(0, wsize[i]));
+      fSlot->Fill(MetricsRegistry::kBytesPerChunk, uncompressed_size[i]);
     }
-    uncompressed.clear();
-    fBytesPerChunk[int(std::log2(uncompressed_size[i]))]++;
     fOutputBufferSize -= uncompressed_size[i];
   }
   fChunks.erase(chunk_i);
   fOverlaps.erase(chunk_i);
+  std::vector<chunk_stats_t> stats(3);
+  if (fWriteMetadata) {
+    stats[0] = std::move(fChunkStats[chunk_i]);
+    stats[1] = stats[2] = std::move(fOverlapStats[chunk_i]);
+    fChunkStats.erase(chunk_i);
+    fOverlapStats.erase(chunk_i);
+  }
 
   out_buffer[2] = out_buffer[1];
   wsize[2] = wsize[1];
@@ -367,32 +560,184 @@ void StraxFormatter::WriteOutChunk(int chunk_i){
   auto names = GetChunkNames(chunk_i);
   for (int i = 0; i < 3; i++) {
     if (uncompressed_size[i] == 0) continue;
-    // write to *_TEMP
-    auto output_dir_temp = GetDirectoryPath(names[i], true);
-    auto filename_temp = GetFilePath(names[i], true);
-    if (!fs::exists(output_dir_temp))
-      fs::create_directory(output_dir_temp);
-    std::ofstream writefile(filename_temp, std::ios::binary);
-    writefile.write(out_buffer[i]->data(), wsize[i]);
-    writefile.close();
+    if (wsize[i] < 0) {
+      // strax can't read it uncompressed, so there's no saving it. The
+      // controller puts itself in error once it sees this
+      fLog->Entry(MongoLog::Error, "Chunk %s from thread %lx couldn't be compressed, %li bytes lost",
+          names[i].c_str(), fThreadId, uncompressed_size[i]);
+      if (i < 2) fChunksLost++;
+      continue;
+    }
+    // if the consumer on the socket can take it, it doesn't go to disk
+    bool streamed = fStreamer && fStreamer->Send(names[i], fFullHostname,
+        out_buffer[i]->data(), wsize[i], uncompressed_size[i]);
+    if (streamed)
+      fStreamed.insert(names[i]);
+    else
+      WriteChunkFile(names[i], out_buffer[i]->data(), wsize[i], uncompressed_size[i]);
     out_buffer[i].reset();
+    if (fWriteMetadata)
+      WriteMetadata(names[i], stats[i], wsize[i], uncompressed_size[i], streamed);
+  } // End writing
+  if (fHitfinder) WriteOutHits(chunk_i);
+  return;
+}
 
-    auto output_dir = GetDirectoryPath(names[i]);
-    auto filename = GetFilePath(names[i]);
-    // shenanigans or skulduggery?
-    if(fs::exists(filename)) {
-      fLog->Entry(MongoLog::Warning, "Chunk %s from thread %lx already exists? %li vs %li bytes (%lx)",
-          names[i].c_str(), fThreadId, fs::file_size(filename), wsize[i], uncompressed_size[i]);
+void StraxFormatter::ApplyCoincidence(int chunk_i) {
+  // Summarizes the pulses in this chunk for the coincidence filter, then drops
+  // the fragments of the ones it doesn't want. Fragments of a channel are in
+  // time order within each buffer, and everything in the overlap buffer comes
+  // after everything in the main one, so pulses can be followed across both.
+  // Deadtime records aren't pulses, they neither count nor get dropped
+  std::list<std::string>* buffers[2] = {&fChunks[chunk_i], &fOverlaps[chunk_i]};
+  const int samples_per_frag = fFragmentBytes>>1;
+  std::vector<CoincidenceFilter::pulse_t> pulses;
+  std::map<int16_t, std::pair<int, size_t>> open; // channel: {baseline, index in pulses}
+  for (auto buffer : buffers) {
+    for (auto& frag : *buffer) {
+      int64_t time = *(const int64_t*)frag.data();
+      int32_t length = *(const int32_t*)(frag.data()+8);
+      int16_t dt = *(const int16_t*)(frag.data()+12), channel = *(const int16_t*)(frag.data()+14);
+      int32_t pulse_length = *(const int32_t*)(frag.data()+16);
+      uint16_t record_i = *(const uint16_t*)(frag.data()+20);
+      if (fADChannels.count(channel)) continue;
+      const uint16_t* samples = (const uint16_t*)(frag.data() + fStraxHeaderSize);
+      auto it = open.find(channel);
+      if (record_i == 0 || it == open.end()) {
+        int baseline = SampleScan::Baseline(samples, std::min(fBaselineSamples, length));
+        int64_t end = time + int64_t(pulse_length - record_i*samples_per_frag)*dt;
+        pulses.push_back({time, end, 0.f, channel});
+        it = open.insert_or_assign(channel, std::make_pair(baseline, pulses.size()-1)).first;
+      }
+      pulses[it->second.second].area += long(it->second.first)*length - SampleScan::Sum(samples, length);
     }
+  }
+  auto passed = fCoincidence->Decide(fCoincidenceID, chunk_i, std::move(pulses));
 
-    // Move this chunk from *_TEMP to the same path without TEMP
-    if(!fs::exists(output_dir))
-      fs::create_directory(output_dir);
+  std::map<int16_t, bool> keep; // decision for the pulse each channel is in
+  for (int i = 0; i < 2; i++) {
+    // the stats were made as fragments came in, so start them over
+    chunk_stats_t* stats = nullptr;
+    if (fWriteMetadata) {
+      stats = &(i == 0 ? fChunkStats : fOverlapStats)[chunk_i];
+      *stats = chunk_stats_t();
+    }
+    for (auto it = buffers[i]->begin(); it != buffers[i]->end(); ) {
+      int64_t time = *(const int64_t*)it->data();
+      int32_t length = *(const int32_t*)(it->data()+8);
+      int16_t dt = *(const int16_t*)(it->data()+12), channel = *(const int16_t*)(it->data()+14);
+      int32_t pulse_length = *(const int32_t*)(it->data()+16);
+      uint16_t record_i = *(const uint16_t*)(it->data()+20);
+      auto k = keep.find(channel);
+      if (record_i == 0 || k == keep.end()) {
+        int64_t end = time + int64_t(pulse_length - record_i*samples_per_frag)*dt;
+        k = keep.insert_or_assign(channel, fADChannels.count(channel) > 0 ||
+            fCoincidence->Keep(passed, chunk_i, time, end, channel)).first;
+      }
+      if (k->second) {
+        if (stats) stats->Add(time, time + int64_t(length)*dt, channel, it->size());
+        it++;
+      } else {
+        fOutputBufferSize -= fFullFragmentSize;
+        it = buffers[i]->erase(it);
+      }
+    }
+  }
+}
+
+void StraxFormatter::WriteOutHits(int chunk_i) {
+  // Hits aren't waveforms, so they skip the prefilter and the grouped layout
+  std::string compressed[2];
+  long wsize[2] = {0, 0}, uncompressed_size[2] = {0, 0};
+  std::map<int, std::string>* buffers[2] = {&fHitChunks, &fHitOverlaps};
+  for (int i = 0; i < 2; i++) {
+    auto it = buffers[i]->find(chunk_i);
+    if (it == buffers[i]->end()) continue;
+    uncompressed_size[i] = it->second.size();
+    wsize[i] = StraxCodec::Compress(fCompressor, fCompressionLevel, it->second.data(),
+        it->second.size(), compressed[i]);
+    buffers[i]->erase(it);
+  }
+  auto names = GetChunkNames(chunk_i);
+  for (int i = 0; i < 3; i++) {
+    int j = std::min(i, 1); // _post and _pre are the same data
+    if (uncompressed_size[j] == 0) continue;
+    if (wsize[j] < 0) {
+      fLog->Entry(MongoLog::Error, "Thread %lx failed to compress hits for %s",
+          fThreadId, names[i].c_str());
+      if (i < 2) fChunksLost++;
+      continue;
+    }
+    WriteChunkFile(names[i], compressed[j].data(), wsize[j], uncompressed_size[j], true);
+  }
+}
+
+void StraxFormatter::WriteChunkFile(const std::string& name, const char* data, long bytes,
+    long uncompressed, bool hits) {
+  // write to *_TEMP
+  auto output_dir_temp = GetDirectoryPath(name, true, hits);
+  auto filename_temp = GetFilePath(name, true, hits);
+  if (!fs::exists(output_dir_temp))
+    fs::create_directory(output_dir_temp);
+  std::ofstream writefile(filename_temp, std::ios::binary);
+  writefile.write(data, bytes);
+  writefile.close();
+
+  auto output_dir = GetDirectoryPath(name, false, hits);
+  auto filename = GetFilePath(name, false, hits);
+  // shenanigans or skulduggery?
+  if(fs::exists(filename)) {
+    fLog->Entry(MongoLog::Warning, "Chunk %s from thread %lx already exists? %li vs %li bytes (%lx)",
+        name.c_str(), fThreadId, fs::file_size(filename), bytes, uncompressed);
+  }
+
+  // Move this chunk from *_TEMP to the same path without TEMP
+  if(!fs::exists(output_dir))
+    fs::create_directory(output_dir);
+  fs::rename(filename_temp, filename);
+}
+
+void StraxFormatter::WriteMetadata(const std::string& name, const chunk_stats_t& stats,
+    long compressed, long uncompressed, bool streamed) {
+  // A small json doc per chunk file so downstream doesn't have to decompress
+  // anything to find out what's in it. Lives outside the chunk directory
+  // because strax reads every file in there
+  using namespace bsoncxx::builder::stream;
+  auto doc = document{} <<
+    "chunk" << name <<
+    "host" << fFullHostname <<
+    "first_time" << stats.first_time <<
+    "last_time" << stats.last_time <<
+    "fragments" << stats.fragments <<
+    "compressed_bytes" << compressed <<
+    "uncompressed_bytes" << uncompressed <<
+    "compressor" << fCompressor <<
+    "compression_level" << fCompressionLevel <<
+    "prefilter" << fPrefilter <<
+    "layout" << (fChannelsPerBlock > 0 ? "grouped" : "interleaved") <<
+    "streamed" << streamed <<
+    "channels" << open_document <<
+      [&](key_context<> chdoc){
+      for (auto& p : stats.per_channel)
+        chdoc << std::to_string(p.first) << open_document <<
+          "fragments" << p.second.first <<
+          "bytes" << p.second.second <<
+          close_document;
+      } << close_document <<
+    finalize;
+  fs::path meta_dir = fs::path(fOutputPath) / "metadata" / name;
+  try {
+    fs::create_directories(meta_dir);
+    fs::path filename = meta_dir / (fFullHostname + ".json");
+    fs::path filename_temp = meta_dir / (fFullHostname + ".json_temp");
+    std::ofstream outfile(filename_temp, std::ios::out);
+    outfile << bsoncxx::to_json(doc.view()) << '\n';
+    outfile.close();
     fs::rename(filename_temp, filename);
-  } // End writing
-  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &comp_end);
-  fCompTime += timespec_subtract(comp_end, comp_start);
-  return;
+  } catch (const std::exception& e) {
+    fLog->Entry(MongoLog::Warning, "Couldn't write metadata for chunk %s: %s",
+        name.c_str(), e.what());
+  }
 }
 
 void StraxFormatter::WriteOutChunks() {
@@ -409,6 +754,15 @@ void StraxFormatter::WriteOutChunks() {
   average_chunk /= tot_frags;
   for (; min_chunk < average_chunk - fBufferNumChunks; min_chunk++)
     WriteOutChunk(min_chunk);
+  // hit chunks that have no fragment chunk of their own don't get written
+  // above, they go once they're as old as the ones that did
+  while (fHitfinder) {
+    int chunk = INT_MAX;
+    if (fHitChunks.size() > 0) chunk = fHitChunks.begin()->first;
+    if (fHitOverlaps.size() > 0) chunk = std::min(chunk, fHitOverlaps.begin()->first);
+    if (chunk >= min_chunk) break;
+    WriteOutHits(chunk);
+  }
   CreateEmpty(min_chunk);
   return;
 }
@@ -421,19 +775,28 @@ void StraxFormatter::End() {
     max_chunk = std::max(max_chunk, fChunks.begin()->first);
     WriteOutChunk(max_chunk);
   }
+  // hits from the tails of pulses can be in a chunk without any fragments
+  while (fHitChunks.size() > 0 || fHitOverlaps.size() > 0) {
+    int chunk = fHitChunks.size() > 0 ? fHitChunks.begin()->first : fHitOverlaps.begin()->first;
+    if (fHitOverlaps.size() > 0) chunk = std::min(chunk, fHitOverlaps.begin()->first);
+    WriteOutHits(chunk);
+  }
   if (max_chunk != -1) CreateEmpty(max_chunk);
   fChunks.clear();
-  auto end_dir = GetDirectoryPath("THE_END");
-  if(!fs::exists(end_dir)){
-    fLog->Entry(MongoLog::Local,"Creating END directory at %s", end_dir.c_str());
-    try{
-      fs::create_directory(end_dir);
+  for (bool hits : {false, true}) {
+    if (hits && !fHitfinder) continue;
+    auto end_dir = GetDirectoryPath("THE_END", false, hits);
+    if(!fs::exists(end_dir)){
+      fLog->Entry(MongoLog::Local,"Creating END directory at %s", end_dir.c_str());
+      try{
+        fs::create_directory(end_dir);
+      }
+      catch(...){};
     }
-    catch(...){};
+    std::ofstream outfile(GetFilePath("THE_END", false, hits), std::ios::out);
+    outfile<<"...my only friend\n";
+    outfile.close();
   }
-  std::ofstream outfile(GetFilePath("THE_END"), std::ios::out);
-  outfile<<"...my only friend\n";
-  outfile.close();
   return;
 }
 
@@ -444,26 +807,30 @@ std::string StraxFormatter::GetStringFormat(int id){
   return chunk_index;
 }
 
-fs::path StraxFormatter::GetDirectoryPath(const std::string& id, bool temp){
-  fs::path write_path(fOutputPath);
+fs::path StraxFormatter::GetDirectoryPath(const std::string& id, bool temp, bool hits){
+  fs::path write_path(hits ? fHitsPath : fOutputPath);
   write_path /= id;
   if(temp)
     write_path+="_temp";
   return write_path;
 }
 
-fs::path StraxFormatter::GetFilePath(const std::string& id, bool temp){
-  return GetDirectoryPath(id, temp) / fFullHostname;
+fs::path StraxFormatter::GetFilePath(const std::string& id, bool temp, bool hits){
+  return GetDirectoryPath(id, temp, hits) / fFullHostname;
 }
 
 void StraxFormatter::CreateEmpty(int back_from){
   for(; fEmptyVerified<back_from; fEmptyVerified++){
     for (auto& n : GetChunkNames(fEmptyVerified)) {
-      if(!fs::exists(GetFilePath(n))){
-        if(!fs::exists(GetDirectoryPath(n)))
-          fs::create_directory(GetDirectoryPath(n));
-        std::ofstream o(GetFilePath(n));
-        o.close();
+      for (bool hits : {false, true}) {
+        if (hits && !fHitfinder) continue;
+        if (!hits && fStreamed.erase(n)) continue; // not empty, just not here
+        if(!fs::exists(GetFilePath(n, false, hits))){
+          if(!fs::exists(GetDirectoryPath(n, false, hits)))
+            fs::create_directory(GetDirectoryPath(n, false, hits));
+          std::ofstream o(GetFilePath(n, false, hits));
+          o.close();
+        }
       }
     } // name
   } // chunks
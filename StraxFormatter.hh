@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <string>
 #include <map>
+#include <set>
 #include <mutex>
 #include <experimental/filesystem>
 #include <numeric>
@@ -15,66 +16,134 @@
 #include <list>
 #include <memory>
 #include <string_view>
+#include <algorithm>
+#include "StraxCodec.hh"
+#include "MetricsRegistry.hh"
 
 class Options;
 class MongoLog;
 class V1724;
+class LiveDataRing;
+class ChunkStreamer;
+class CoincidenceFilter;
+class ChannelPrescaler;
 
 struct data_packet{
-  data_packet() : clock_counter(0), header_time(0) {}
-  data_packet(std::u32string s, uint32_t ht, long cc) :
-      buff(std::move(s)), clock_counter(cc), header_time(ht) {}
+  /*
+    One readout of one board, with where each event starts and its full
+    64-bit time, both worked out by the readout thread in the order the board
+    recorded them. Big ones get split into several packets at event
+    boundaries (DAQController::ReadData) so more than one formatter can work
+    on them, in which case they share the storage and each one only looks at
+    its own part of it
+  */
+  data_packet() {}
+  data_packet(std::u32string s) :
+      storage(std::make_shared<const std::u32string>(std::move(s))), buff(*storage) {}
+  data_packet(const std::shared_ptr<const std::u32string>& s, std::u32string_view piece) :
+      storage(s), buff(piece) {}
   data_packet(const data_packet& rhs)=delete;
-  data_packet(data_packet&& rhs) : buff(std::move(rhs.buff)),
-      clock_counter(rhs.clock_counter), header_time(rhs.header_time), digi(rhs.digi) {}
-  ~data_packet() {buff.clear(); digi.reset();}
+  data_packet(data_packet&& rhs) : storage(std::move(rhs.storage)), buff(rhs.buff),
+      events(std::move(rhs.events)), times(std::move(rhs.times)),
+      deadtime(std::move(rhs.deadtime)), digi(rhs.digi) {}
+  ~data_packet() {storage.reset(); digi.reset();}
 
   data_packet& operator=(const data_packet& rhs)=delete;
   data_packet& operator=(data_packet&& rhs) {
-    buff=std::move(rhs.buff);
-    clock_counter=rhs.clock_counter;
-    header_time=rhs.header_time;
+    storage=std::move(rhs.storage);
+    buff=rhs.buff;
+    events=std::move(rhs.events);
+    times=std::move(rhs.times);
+    deadtime=std::move(rhs.deadtime);
     digi=rhs.digi;
     return *this;
   }
 
-  std::u32string buff;
-  long clock_counter;
-  uint32_t header_time;
+  std::shared_ptr<const std::u32string> storage;
+  std::u32string_view buff; // what this packet covers of storage
+  std::vector<uint32_t> events; // offsets of the event headers in buff
+  std::vector<int64_t> times; // of each event, in clock cycles
+  std::vector<std::pair<int64_t, int64_t>> deadtime; // [start, end) ns the board was busy
   std::shared_ptr<V1724> digi;
 };
 
+struct chunk_stats_t{
+  // Accumulated as fragments are buffered, written next to each chunk
+  chunk_stats_t() : first_time(INT64_MAX), last_time(0), fragments(0) {}
+  void Add(int64_t start, int64_t end, int16_t channel, long bytes) {
+    first_time = std::min(first_time, start);
+    last_time = std::max(last_time, end);
+    fragments++;
+    auto& ch = per_channel[channel];
+    ch.first++;
+    ch.second += bytes;
+  }
+
+  int64_t first_time, last_time;
+  long fragments;
+  std::map<int16_t, std::pair<long, long>> per_channel; // {fragments, bytes}
+};
+
+// One entry in the hits output, see the hitfinder options
+struct hit_t{
+  int64_t time; // ns, first sample over threshold
+  int32_t length; // samples
+  int16_t dt;
+  int16_t channel;
+  float area; // ADC counts x samples below baseline
+  int16_t height; // ADC counts below baseline of the lowest sample
+  int16_t reserved;
+};
+
 class StraxFormatter{
   /*
     Reformats raw data into strax format
   */
 
 public:
-  StraxFormatter(std::shared_ptr<Options>&, std::shared_ptr<MongoLog>&);
+  StraxFormatter(std::shared_ptr<Options>&, std::shared_ptr<MongoLog>&,
+      std::shared_ptr<LiveDataRing>&, std::shared_ptr<ChunkStreamer>&,
+      std::shared_ptr<CoincidenceFilter>&, std::shared_ptr<ChannelPrescaler>&,
+      std::shared_ptr<MetricsRegistry>&);
   ~StraxFormatter();
 
   void Close(std::map<int,int>& ret);
 
   void Process();
   std::pair<int, int> GetBufferSize() {return {fInputBufferSize.load(), fOutputBufferSize.load()};}
-  void GetDataPerChan(std::map<int, int>& ret);
+  long GetChunksLost() {return fChunksLost;}
+  void GetZLEStats(std::map<int, std::pair<long, long>>& ret);
   void ReceiveDatapackets(std::list<std::unique_ptr<data_packet>>&, int);
 
 private:
   void ProcessDatapacket(std::unique_ptr<data_packet> dp);
-  int ProcessEvent(std::u32string_view, const std::unique_ptr<data_packet>&,
-      std::map<int, int>&);
-  int ProcessChannel(std::u32string_view, int, int, uint32_t, int&, int,
-      const std::unique_ptr<data_packet>&, std::map<int, int>&);
+  // templated on the board's format from DigitizerFormats
+  template<typename Format>
+  void ProcessPacket(std::unique_ptr<data_packet>, const Format&);
+  template<typename Format>
+  int ProcessEvent(std::u32string_view, int64_t, const std::unique_ptr<data_packet>&,
+      std::vector<int16_t>&, const Format&);
+  void ProcessChannel(const uint16_t*, uint32_t, int64_t, uint16_t, int16_t, uint16_t, int64_t,
+      int&);
+  std::vector<int16_t>& GetChannelMap(const std::shared_ptr<V1724>&);
+  int EmitPulse(const uint16_t*, uint32_t, int64_t, uint16_t, int16_t, uint16_t, int64_t);
   void WriteOutChunk(int);
+  long Compress(const std::string&, std::string&);
+  long CompressGrouped(std::list<std::string>&, std::string&);
+  void ApplyCoincidence(int);
+  void WriteOutHits(int);
+  void WriteChunkFile(const std::string&, const char*, long, long, bool=false);
+  void FindHits(const uint16_t*, uint32_t, int, int64_t, uint16_t, int16_t);
+  std::pair<int, bool> GetChunk(int64_t);
+  void WriteMetadata(const std::string&, const chunk_stats_t&, long, long, bool);
   void WriteOutChunks();
   void End();
-  void GenerateArtificialDeadtime(int64_t, const std::shared_ptr<V1724>&);
-  void AddFragmentToBuffer(std::string, uint32_t, int);
+  void GenerateArtificialDeadtime(int64_t, int64_t, const std::shared_ptr<V1724>&);
+  void AddFragmentToBuffer(std::string, int64_t);
   std::vector<std::string> GetChunkNames(int);
 
-  std::experimental::filesystem::path GetFilePath(const std::string&, bool=false);
-  std::experimental::filesystem::path GetDirectoryPath(const std::string&, bool=false);
+  std::experimental::filesystem::path GetFilePath(const std::string&, bool=false, bool=false);
+  std::experimental::filesystem::path GetDirectoryPath(const std::string&, bool=false, bool=false);
   std::string GetStringFormat(int id);
   void CreateEmpty(int);
   int fEmptyVerified;
@@ -88,23 +157,42 @@ private:
   int fWarnIfChunkOlderThan;
   unsigned fChunkNameLength;
   int64_t fFullChunkLength;
-  std::string fOutputPath, fHostname, fFullHostname;
+  std::string fOutputPath, fHitsPath, fHostname, fFullHostname;
   std::shared_ptr<Options> fOptions;
   std::shared_ptr<MongoLog> fLog;
+  std::shared_ptr<LiveDataRing> fLiveRing;
+  std::shared_ptr<ChunkStreamer> fStreamer;
+  std::shared_ptr<CoincidenceFilter> fCoincidence;
+  int fCoincidenceID;
+  std::set<int16_t> fADChannels; // artificial deadtime, seen so far
+  std::shared_ptr<ChannelPrescaler> fPrescaler;
+  std::map<int16_t, unsigned> fPrescaleCounter;
+  std::shared_ptr<MetricsRegistry> fMetrics;
+  MetricsRegistry::slot_t* fSlot;
+  bool fCounting, fTiming;
+  std::set<std::string> fStreamed;
   std::atomic_bool fActive;
   std::string fCompressor;
+  int fCompressionLevel; // <0 for the compressor's default
+  std::string fPrefilter; // "none" or "delta_shuffle", see WaveformFilter
   std::map<int, std::list<std::string>> fChunks, fOverlaps;
+  std::map<int, chunk_stats_t> fChunkStats, fOverlapStats;
+  bool fWriteMetadata;
+  int fChannelsPerBlock; // 0 means the usual interleaved layout
+  bool fZLE;
+  int fZLEThreshold, fZLEPre, fZLEPost, fBaselineSamples;
+  std::vector<std::pair<int, int>> fZLERuns;
+  bool fHitfinder;
+  int fHitThreshold;
+  std::map<int16_t, int> fHitThresholds;
+  std::vector<std::pair<int, int>> fHitRuns;
+  std::map<int, std::string> fHitChunks, fHitOverlaps;
+  std::map<int, std::pair<long, long>> fZLEStats; // {samples in, samples kept}
   std::map<int, int> fFailCounter;
-  std::map<int, int> fDataPerChan;
-  std::mutex fDPC_mutex;
-  std::map<int, long> fBufferCounter;
-  std::map<int, long> fFragsPerEvent;
-  std::map<int, long> fEvPerDP;
-  std::map<int, long> fBytesPerChunk;
+  std::map<int, std::vector<int16_t>> fChannelMap; // {bid: {board channel: global channel}}
   std::atomic_int fInputBufferSize, fOutputBufferSize;
+  std::atomic_long fChunksLost; // couldn't be compressed
   long fBytesProcessed;
-
-  double fProcTimeDP, fProcTimeEv, fProcTimeCh, fCompTime;
   std::thread::id fThreadId;
   std::condition_variable fCV;
   std::mutex fBufferMutex;
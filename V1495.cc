@@ -8,6 +8,7 @@
 #include "DAXHelpers.hh"
 #include "Options.hh"
 #include "MongoLog.hh"
+#include "VMEBackend.hh"
 
 
 V1495::V1495(std::shared_ptr<MongoLog>& log, std::shared_ptr<Options>& options, int bid, int handle, unsigned int address){
@@ -16,16 +17,15 @@ V1495::V1495(std::shared_ptr<MongoLog>& log, std::shared_ptr<Options>& options,
 	fBID = bid;
 	fBaseAddress = address;
 	fBoardHandle = handle;
+	// the crate controller's handle, so the same backend it has
+	fVME = VMEBackend::Get(options);
 }
 
 V1495::~V1495(){}
 
 // Kept a separate write registers function for the V1495 here, but in principle can be derived from the V1724 class
 int V1495::WriteReg(unsigned int reg, unsigned int value){
-	u_int32_t write=0;
-	write+=value;
-	if(CAENVME_WriteCycle(fBoardHandle, fBaseAddress+reg,
-				&write,cvA32_U_DATA,cvD32) != cvSuccess){
+	if(fVME->WriteRegister(fBoardHandle, fBaseAddress+reg, value) != VMEBackend::kSuccess){
 		fLog->Entry(MongoLog::Warning, "V1495: %i failed to write register 0x%04x with value %08x (handle %i)", 
 				fBID, reg, value, fBoardHandle);
 		return -1;
@@ -1,7 +1,6 @@
 #ifndef _V1495_HH_
 #define _V1495_HH_
 
-#include <CAENVMElib.h>
 #include "MongoLog.hh"
 #include "Options.hh"
 #include "V1724.hh"
@@ -21,6 +20,8 @@
 
 using namespace std;
 
+class VMEBackend;
+
 class V1495{
 
 public:
@@ -29,6 +30,7 @@ public:
       int WriteReg(unsigned int reg, unsigned int value);
 
 private:
+      std::shared_ptr<VMEBackend> fVME;
       int fBoardHandle, fBID;
       unsigned int fBaseAddress;
       std::shared_ptr<Options> fOptions;
@@ -2,9 +2,10 @@
 #include "MongoLog.hh"
 #include "Options.hh"
 #include "StraxFormatter.hh"
+#include "HeaderScan.hh"
 #include <algorithm>
 #include <cmath>
-#include <CAENVMElib.h>
+#include "VMEBackend.hh"
 #include <sstream>
 #include <list>
 #include <utility>
@@ -28,19 +29,33 @@ V1724::V1724(std::shared_ptr<MongoLog>& log, std::shared_ptr<Options>& opts, int
   fBoardFailStatRegister = 0x8178;
   fReadoutStatusRegister = 0xEF04;
   fBoardErrRegister = 0xEF00;
+  fEventStoredRegister = 0x812C;
+  fEventSizeRegister = 0x814C;
   fError = false;
 
-  fSampleWidth = 10;
-  fClockCycle = 10;
+  fSampleWidth = DigitizerFormats::V1724Format::kSampleWidth;
+  fClockCycle = DigitizerFormats::V1724Format::kClockWidth;
+  fFormat = DigitizerFormats::kV1724;
+  fFormatOwner = &typeid(V1724);
   fBID = bid;
   fBaseAddress=address;
-  fRolloverCounter = 0;
-  fLastClock = 0;
+  fLastTime = 0;
+  fLastEventCounter = -1;
   fBLTSafety = opts->GetDouble("blt_safety_factor", 1.5);
   BLT_SIZE = opts->GetInt("blt_size", 512*1024);
-  // there's a more elegant way to do this, but I'm not going to write it
-  fClockPeriod = std::chrono::nanoseconds((1l<<31)*fClockCycle);
+  fSizeBLTs = opts->GetString("blt_sizing", "fixed") == "events";
+  fTuneWindow = opts->GetInt("blt_autotune", 0) ? std::max(10, opts->GetInt("blt_autotune_reads", 1000)) : 0;
+  fTuneMin = std::max(8, opts->GetInt("blt_size_min", 16*1024)) & ~7;
+  fTuneMax = std::max(fTuneMin, opts->GetInt("blt_size_max", 4*1024*1024)) & ~7;
+  fTuneReads = fTuneBLTs = fTuneMaxBytes = 0;
   fArtificialDeadtimeChannel = 790;
+  fBytesRead = 0;
+  fBLTsSaved = 0;
+  fSkippedWords = 0;
+  fEventsRead = fMissedEvents = fMissedBytes = 0;
+  fWordsRead = 0;
+  fBusySince = -1;
+  fBusyWall = fDeadtime = fBusyIntervals = 0;
 
   if (Init(link, crate, opts)) {
     throw std::runtime_error("Board init failed");
@@ -53,12 +68,14 @@ V1724::~V1724(){
   std::stringstream msg;
   msg << "BLT report for board " << fBID << " (BLT " << BLT_SIZE << ")";
   for (auto p : fBLTCounter) msg << " | " << p.first << " " << int(std::log2(p.second));
+  if (fBLTsSaved > 0) msg << " | saved " << int(std::log2(fBLTsSaved));
   fLog->Entry(MongoLog::Local, msg.str());
 }
 
 int V1724::Init(int link, int crate, std::shared_ptr<Options>& opts) {
-  int a = CAENVME_Init(cvV2718, link, crate, &fBoardHandle);
-  if(a != cvSuccess){
+  fVME = VMEBackend::Get(opts);
+  int a = fVME->Init(link, crate, fBoardHandle);
+  if(a != VMEBackend::kSuccess){
     fLog->Entry(MongoLog::Warning, "Board %i failed to init, error %i handle %i link %i bdnum %i",
             fBID, a, fBoardHandle, link, crate);
     fBoardHandle = -1;
@@ -97,13 +114,13 @@ int V1724::Init(int link, int crate, std::shared_ptr<Options>& opts) {
 }
 
 int V1724::SINStart(){
-  fLastClockTime = std::chrono::high_resolution_clock::now();
+  fLastClockTime = std::chrono::steady_clock::now();
   return WriteRegister(fAqCtrlRegister,0x105);
 }
 int V1724::SoftwareStart(){
-  fLastClockTime = std::chrono::high_resolution_clock::now();
-  fRolloverCounter = 0;
-  fLastClock = 0;
+  fLastClockTime = std::chrono::steady_clock::now();
+  fLastTime = 0;
+  fLastEventCounter = -1;
   return WriteRegister(fAqCtrlRegister, 0x104);
 }
 int V1724::AcquisitionStop(bool){
@@ -125,8 +142,8 @@ uint32_t V1724::GetAcquisitionStatus(){
   return ReadRegister(fAqStatusRegister);
 }
 int V1724::ResetClocks() {
-  fRolloverCounter = 0;
-  fLastClock = 0;
+  fLastTime = 0;
+  fLastEventCounter = -1;
   return WriteRegister(fClearRegister, 0x1);
 }
 int V1724::CheckErrors(){
@@ -146,53 +163,73 @@ int V1724::Reset() {
   return ret;
 }
 
-std::tuple<uint32_t, long> V1724::GetClockInfo(std::u32string_view sv) {
-  auto it = sv.begin();
-  do {
-    if ((*it)>>28 == 0xA) {
-      uint32_t ht = *(it+3)&0x7FFFFFFF;
-      return {ht, GetClockCounter(ht)};
+void V1724::IndexEvents(std::unique_ptr<data_packet>& dp, std::chrono::steady_clock::time_point now) {
+  // Walks the events in the order the board recorded them and gives each one
+  // its full 64-bit time. The trigger time tag has 31 bits of 10 ns so it
+  // rolls over every 21 s, but consecutive events are never half of that
+  // apart within one readout, so each one extends the one before it. Between
+  // readouts the board might have been quiet for longer, so the first event
+  // starts from the middle of the time since the last data we saw. This
+  // happens once per readout and in order, so the formatters can process the
+  // pieces of a packet in any order and only ever add. With readout_async
+  // this isn't the readout thread, hence the lock for what TrackBusy looks at
+  std::unique_lock<std::mutex> lk(fClockMutex);
+  int64_t last_time = fLastTime;
+  int64_t time = last_time + std::chrono::duration_cast<std::chrono::nanoseconds>(
+      now - fLastClockTime).count()/fClockCycle/2;
+  lk.unlock();
+  const char32_t* buff = dp->buff.data();
+  size_t n = dp->buff.size(), idx = 0;
+  // one word or so per event, hops from header to header so it's cheap next
+  // to the copy we just made. Junk between events stays out of the index
+  long missed = 0, words = 0;
+  int first_gap = -1;
+  while ((idx = HeaderScan::NextEvent(buff, n, idx)) < n) {
+    time = DigitizerFormats::Extend(time, buff[idx+3]&0x7FFFFFFF);
+    dp->events.push_back(idx);
+    dp->times.push_back(time);
+    // 24-bit event counter, same place for all our formats. A step back is
+    // an event that came late rather than one that's lost (f1724 makes its
+    // events on two threads), so it fills a gap we counted before
+    int counter = buff[idx+2]&0xFFFFFF;
+    int step = (counter - fLastEventCounter)&0xFFFFFF;
+    if (fLastEventCounter < 0 || step == 1) {
+      fLastEventCounter = counter;
+    } else if (step > 0x800000) {
+      missed--;
+    } else if (step > 1) {
+      if (first_gap < 0) first_gap = fLastEventCounter;
+      missed += step - 1;
+      fLastEventCounter = counter;
     }
-  } while (++it < sv.end());
-  fLog->Entry(MongoLog::Message, "No clock info for %i?", fBID);
-  return {0xFFFFFFFF, -1};
-}
-
-int V1724::GetClockCounter(uint32_t timestamp){
-  // The V1724 has a 31-bit on board clock counter that counts 10ns samples.
-  // So it will reset every 21 seconds. We need to count the resets or we
-  // can't run longer than that. We can employ some clever logic
-  // and real-time time differences to handle clock rollovers and catch any
-  // that we happen to miss the usual way
-
-  auto now = std::chrono::high_resolution_clock::now();
-  std::chrono::nanoseconds dt = now - fLastClockTime;
-  fLastClockTime += dt; // no operator=
-
-  int n_missed = dt / fClockPeriod;
-  if (n_missed > 0) {
-    fLog->Entry(MongoLog::Message, "Board %i missed %i rollovers", fBID, n_missed);
-    fRolloverCounter += n_missed;
+    words += buff[idx]&0xFFFFFFF;
+    idx += buff[idx]&0xFFFFFFF;
   }
-
-  if (timestamp < fLastClock) {
-    // actually rolled over
-    fRolloverCounter++;
-    fLog->Entry(MongoLog::Local, "Board %i rollover %i (%x/%x)",
-        fBID, fRolloverCounter, fLastClock, timestamp);
-  } else {
-    // not a rollover
+  fEventsRead += dp->events.size();
+  fWordsRead += words;
+  if (missed > 0 && fMissedEvents == 0)
+    fLog->Entry(MongoLog::Warning, "Board %i is losing events: %li missing after event %x",
+        fBID, missed, first_gap);
+  if (missed != 0 && fEventsRead > 0) {
+    missed = std::max(missed, -fMissedEvents);
+    fMissedEvents += missed;
+    fMissedBytes = std::max(0l, fMissedBytes + missed*fWordsRead/fEventsRead*long(sizeof(char32_t)));
+  }
+  if (dp->events.empty()) {
+    fLog->Entry(MongoLog::Message, "No clock info for %i?", fBID);
+    return;
   }
-  fLastClock = timestamp;
-  return fRolloverCounter;
+  if ((time >> 31) != (last_time >> 31))
+    fLog->Entry(MongoLog::Local, "Board %i rollover %li (%lx/%lx)",
+        fBID, time >> 31, last_time, time);
+  lk.lock();
+  fLastTime = time;
+  fLastClockTime = now;
 }
 
 int V1724::WriteRegister(unsigned int reg, unsigned int value){
-  uint32_t write=0;
-  write+=value;
   int ret = 0;
-  if((ret = CAENVME_WriteCycle(fBoardHandle, fBaseAddress+reg,
-			&write,cvA32_U_DATA,cvD32)) != cvSuccess){
+  if((ret = fVME->WriteRegister(fBoardHandle, fBaseAddress+reg, value)) != VMEBackend::kSuccess){
     fLog->Entry(MongoLog::Warning,
 		"Board %i write returned %i (ret), reg 0x%04x, value 0x%08x",
 		fBID, ret, reg, value);
@@ -202,10 +239,9 @@ int V1724::WriteRegister(unsigned int reg, unsigned int value){
 }
 
 unsigned int V1724::ReadRegister(unsigned int reg){
-  unsigned int temp;
+  uint32_t temp = 0;
   int ret = -100;
-  if((ret = CAENVME_ReadCycle(fBoardHandle, fBaseAddress+reg, &temp,
-			      cvA32_U_DATA, cvD32)) != cvSuccess){
+  if((ret = fVME->ReadRegister(fBoardHandle, fBaseAddress+reg, temp)) != VMEBackend::kSuccess){
     fLog->Entry(MongoLog::Warning,
 		"Board %i read returned: %i (ret) 0x%08x (val) for reg 0x%04x",
 		fBID, ret, temp, reg);
@@ -215,11 +251,31 @@ unsigned int V1724::ReadRegister(unsigned int reg){
 }
 
 int V1724::Read(std::unique_ptr<data_packet>& outptr){
-  if ((GetAcquisitionStatus() & 0x8) == 0) return 0;
+  uint32_t status = GetAcquisitionStatus();
+  if (status != 0xFFFFFFFF) TrackBusy(status & 0x10);
+  if ((status & 0x8) == 0) return 0;
   // Initialize
   int blt_words=0, nb=0, ret=-5;
   std::list<std::pair<char32_t*, int>> xfer_buffers;
 
+  // With blt_sizing "events" we ask the board how many events it has and stop
+  // once we have that many, rather than reading until it runs out, which
+  // takes a BLT that ends in a bus error. With only one event waiting we know
+  // its size too, so that transfer is exactly as big as it needs to be
+  uint32_t stored = 0, walked = 0;
+  int request = BLT_SIZE, next = 0;
+  if (fSizeBLTs) {
+    stored = ReadRegister(fEventStoredRegister);
+    if (stored == 0) return 0;
+    if (stored == 0xFFFFFFFF) stored = 0; // can't tell, read like usual
+    else if (stored == 1) {
+      uint32_t size = ReadRegister(fEventSizeRegister)*sizeof(char32_t);
+      if (size > 0 && size < (uint32_t)BLT_SIZE) request = (size + 7) & ~7u; // 64-bit transfers
+    }
+  }
+  auto walk = xfer_buffers.begin();
+  int walk_start = 0;
+
   int count = 0;
   int alloc_words = BLT_SIZE/sizeof(char32_t)*fBLTSafety;
   char32_t* thisBLT = nullptr;
@@ -228,10 +284,8 @@ int V1724::Read(std::unique_ptr<data_packet>& outptr){
     // Reserve space for this block transfer
     thisBLT = new char32_t[alloc_words];
 
-    ret = CAENVME_FIFOBLTReadCycle(fBoardHandle, fBaseAddress,
-				     ((unsigned char*)thisBLT),
-				     BLT_SIZE, cvA32_U_MBLT, cvD64, &nb);
-    if( (ret != cvSuccess) && (ret != cvBusError) ){
+    ret = fVME->BLTRead(fBoardHandle, fBaseAddress, thisBLT, request, nb);
+    if( (ret != VMEBackend::kSuccess) && (ret != VMEBackend::kBusError) ){
       fLog->Entry(MongoLog::Error,
 		  "Board %i read error after %i reads: (%i) and transferred %i bytes this read",
 		  fBID, count, ret, nb);
@@ -241,15 +295,36 @@ int V1724::Read(std::unique_ptr<data_packet>& outptr){
       for (auto& b : xfer_buffers) delete[] b.first;
       return -1;
     }
-    if (nb > BLT_SIZE) fLog->Entry(MongoLog::Message,
+    if (nb > request) fLog->Entry(MongoLog::Message,
         "Board %i got %i more bytes than asked for (headroom %i)",
-        fBID, nb-BLT_SIZE, alloc_words*sizeof(char32_t)-nb);
+        fBID, nb-request, alloc_words*sizeof(char32_t)-nb);
 
     count++;
     blt_words+=nb/sizeof(char32_t);
     xfer_buffers.emplace_back(std::make_pair(thisBLT, nb/sizeof(char32_t)));
+    request = BLT_SIZE;
+
+    if (stored > 0 && ret == VMEBackend::kSuccess) {
+      // hop over the event headers we have so far, events can straddle transfers
+      if (walk == xfer_buffers.end()) walk = xfer_buffers.begin();
+      while (next < blt_words) {
+        while (next >= walk_start + walk->second) walk_start += (walk++)->second;
+        uint32_t word = walk->first[next - walk_start];
+        if (word>>28 != 0xA || (word&0xFFFFFFF) < 4) {
+          stored = 0; // lost track, read until the bus error like usual
+          break;
+        }
+        next += word&0xFFFFFFF;
+        walked++;
+      }
+      if (stored > 0 && next == blt_words && walked >= stored) {
+        // all there and ends on an event, the next one would only get the bus error
+        fBLTsSaved++;
+        break;
+      }
+    }
 
-  }while(ret != cvBusError);
+  }while(ret != VMEBackend::kBusError);
 
   /*Now, unfortunately we need to make one copy of the data here or else our memory
     usage explodes. We declare above a buffer of several MB, which is the maximum capacity
@@ -267,13 +342,75 @@ int V1724::Read(std::unique_ptr<data_packet>& outptr){
       s.append(xfer.first, xfer.second);
     }
     fBLTCounter[count]++;
-    auto [ht, cc] = GetClockInfo(s);
-    outptr = std::make_unique<data_packet>(std::move(s), ht, cc);
+    MakePacket(std::move(s), outptr);
+    if (fTuneWindow > 0) {
+      fTuneReads++;
+      fTuneBLTs += count;
+      fTuneMaxBytes = std::max<long>(fTuneMaxBytes, blt_words*sizeof(char32_t));
+      if (fTuneReads >= fTuneWindow) TuneBLT();
+    }
   }
   for (auto b : xfer_buffers) delete[] b.first;
   return blt_words;
 }
 
+void V1724::MakePacket(std::u32string s, std::unique_ptr<data_packet>& outptr) {
+  fBytesRead += s.size()*sizeof(char32_t);
+  outptr = std::make_unique<data_packet>(std::move(s));
+  outptr->deadtime.swap(fPendingDeadtime);
+}
+
+void V1724::TuneBLT() {
+  // More than one BLT per read on average means we're paying round trips
+  // that a bigger transfer would save. If even the biggest read in a while
+  // would have fit in a quarter of the transfer, we're allocating (and
+  // touching) a lot of memory for nothing. Either way in factors of two and
+  // within [blt_size_min, blt_size_max]
+  double blts_per_read = double(fTuneBLTs)/fTuneReads;
+  int size = BLT_SIZE, new_size = size;
+  if (blts_per_read > 1.5)
+    new_size = std::min<long>(fTuneMax, 2L*size);
+  else if (blts_per_read < 1.1 && fTuneMaxBytes*4 < size)
+    new_size = std::max(fTuneMin, size/2) & ~7;
+  if (new_size != size) {
+    fLog->Entry(MongoLog::Local, "Board %i BLT size %i -> %i (%.2f BLTs per read, biggest read %li bytes)",
+        fBID, size, new_size, blts_per_read, fTuneMaxBytes);
+    BLT_SIZE = new_size;
+  }
+  fTuneReads = fTuneBLTs = fTuneMaxBytes = 0;
+}
+
+void V1724::TrackBusy(bool full) {
+  // While the memory is full the board drops triggers, so that's deadtime.
+  // The bit comes from the status poll before every read, so the intervals
+  // are good to within a read. Only the transitions need a clock
+  if (full == (fBusySince >= 0)) return;
+  auto now = std::chrono::steady_clock::now();
+  // board time, from the last event we saw
+  std::unique_lock<std::mutex> lk(fClockMutex);
+  int64_t t = fLastTime*fClockCycle + std::chrono::duration_cast<std::chrono::nanoseconds>(
+      now - fLastClockTime).count();
+  lk.unlock();
+  long wall = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+  if (full) {
+    fBusySince = t;
+    fBusyWall = wall;
+    return;
+  }
+  fPendingDeadtime.emplace_back(fBusySince, std::max(t, fBusySince + fClockCycle));
+  fBusyIntervals++;
+  fDeadtime += wall - fBusyWall;
+  fBusyWall = 0;
+  fBusySince = -1;
+}
+
+long V1724::GetDeadtime() {
+  long since = fBusyWall;
+  if (since == 0) return fDeadtime;
+  return fDeadtime + std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count() - since;
+}
+
 int V1724::LoadDAC(std::vector<uint16_t> &dac_values){
   // Loads DAC values into registers
   for(unsigned int x=0; x<fNChannels; x++){
@@ -295,8 +432,8 @@ int V1724::SetThresholds(std::vector<uint16_t> vals) {
 }
 
 int V1724::End(){
-  if(fBoardHandle>=0)
-    CAENVME_End(fBoardHandle);
+  if(fBoardHandle>=0 && fVME)
+    fVME->End(fBoardHandle);
   fBoardHandle=-1;
   fBaseAddress=0;
   return 0;
@@ -337,19 +474,13 @@ bool V1724::MonitorRegister(uint32_t reg, uint32_t mask, int ntries, int sleep,
 
 std::tuple<int, int, bool, uint32_t> V1724::UnpackEventHeader(std::u32string_view sv) {
   // returns {words this event, channel mask, board fail, header timestamp}
-  return {sv[0]&0xFFFFFFF, sv[1]&0xFF, sv[1]&0x4000000, sv[3]&0x7FFFFFFF};
+  auto h = DigitizerFormats::V1724Format::EventHeader(sv);
+  return {h.words, h.channel_mask, h.fail, h.time};
 }
 
-std::tuple<int64_t, int, uint16_t, std::u32string_view> V1724::UnpackChannelHeader(std::u32string_view sv, long rollovers, uint32_t header_time, uint32_t, int, int) {
+std::tuple<int64_t, int, uint16_t, std::u32string_view> V1724::UnpackChannelHeader(std::u32string_view sv, int64_t event_time, int event_words, int n_channels) {
   // returns {timestamp (ns), words this channel, baseline, waveform}
-  long ch_time = sv[1]&0x7FFFFFFF;
-  int words = sv[0]&0x7FFFFF;
-  // More rollover logic here, because channels are independent and the
-  // processing is multithreaded. We leverage the fact that readout windows are
-  // short and polled frequently compared to the rollover timescale, so there
-  // will never be a large difference in timestamps in one data packet
-  if (ch_time > 15e8 && header_time < 5e8 && rollovers != 0) rollovers--;
-  else if (ch_time < 5e8 && header_time > 15e8) rollovers++;
-  return {((rollovers<<31)+ch_time)*fClockCycle, words, 0, sv.substr(2, words-2)};
+  auto h = DigitizerFormats::V1724Format::ChannelHeader(sv, event_time, event_words, n_channels);
+  return {h.timestamp, h.words, h.baseline, h.wf};
 }
 
@@ -7,10 +7,15 @@
 #include <chrono>
 #include <memory>
 #include <atomic>
+#include <mutex>
 #include <tuple>
+#include <string>
+#include <typeinfo>
+#include "DigitizerFormats.hh"
 
 class MongoLog;
 class Options;
+class VMEBackend;
 class data_packet;
 
 class V1724{
@@ -19,7 +24,15 @@ class V1724{
   V1724(std::shared_ptr<MongoLog>&, std::shared_ptr<Options>&, int, int, int, unsigned=0);
   virtual ~V1724();
 
+  // Only the transfer, IndexEvents goes over the packet before it's used
   virtual int Read(std::unique_ptr<data_packet>&);
+  // What Read does with the data once it has it, for data read out some
+  // other way (CBLTChain)
+  void MakePacket(std::u32string, std::unique_ptr<data_packet>&);
+  // Where the events start and when they happened, given when the packet was
+  // read. In the order the packets were read, but not necessarily on the
+  // readout thread
+  void IndexEvents(std::unique_ptr<data_packet>&, std::chrono::steady_clock::time_point);
   virtual int WriteRegister(unsigned int reg, unsigned int value);
   virtual unsigned int ReadRegister(unsigned int reg);
   virtual int End();
@@ -28,6 +41,10 @@ class V1724{
   uint16_t SampleWidth() {return fSampleWidth;}
   int GetClockWidth() {return fClockCycle;}
   int16_t GetADChannel() {return fArtificialDeadtimeChannel;}
+  // Subclasses that don't set a format of their own get kGeneric, so that
+  // their Unpack functions get used
+  DigitizerFormats::Format GetFormat() {
+    return typeid(*this) == *fFormatOwner ? fFormat : DigitizerFormats::kGeneric;}
 
   virtual int LoadDAC(std::vector<uint16_t>&);
   void ClampDACValues(std::vector<uint16_t>&, std::map<std::string, std::vector<double>>&);
@@ -35,9 +52,28 @@ class V1724{
   int SetThresholds(std::vector<uint16_t> vals);
 
   virtual std::tuple<int, int, bool, uint32_t> UnpackEventHeader(std::u32string_view);
-  virtual std::tuple<int64_t, int, uint16_t, std::u32string_view> UnpackChannelHeader(std::u32string_view, long, uint32_t, uint32_t, int, int);
+  virtual std::tuple<int64_t, int, uint16_t, std::u32string_view> UnpackChannelHeader(std::u32string_view, int64_t, int, int);
 
   bool CheckFail(bool val=false) {bool ret = fError; fError = val; return ret;}
+  // {BLTs per read: reads}, only once the readout thread is done
+  const std::map<int, long>& GetBLTCounter() {return fBLTCounter;}
+  long GetBLTsSaved() {return fBLTsSaved;}
+  long GetBytesRead() {return fBytesRead;}
+  int GetBLTSize() {return BLT_SIZE;}
+  // words the formatters had to skip to find the next event, from any thread
+  void AddSkippedWords(long n) {fSkippedWords += n;}
+  long GetSkippedWords() {return fSkippedWords;}
+  // From gaps in the event counter: events the board recorded that never
+  // made it to us, and about how much data that was going by the average
+  // event size
+  long GetEventsRead() {return fEventsRead;}
+  long GetMissedEvents() {return fMissedEvents;}
+  long GetMissedBytes() {return fMissedBytes;}
+  // ns this run the board's memory was full, including now if it still is
+  long GetDeadtime();
+  long GetBusyIntervals() {return fBusyIntervals;}
+  // memory full as of the last read, readout thread only
+  bool IsFull() {return fBusySince >= 0;}
 
   // Acquisition Control
 
@@ -70,29 +106,48 @@ protected:
   unsigned int fReadoutStatusRegister;
   unsigned int fVMEAlignmentRegister;
   unsigned int fBoardErrRegister;
-
-  int BLT_SIZE;
+  unsigned int fEventStoredRegister;
+  unsigned int fEventSizeRegister;
+
+  std::atomic_int BLT_SIZE; // changes at runtime with blt_autotune
+  bool fSizeBLTs;
+  // blt_autotune, what the reads since the last adjustment looked like
+  int fTuneWindow, fTuneMin, fTuneMax;
+  long fTuneReads, fTuneBLTs, fTuneMaxBytes;
+  void TuneBLT();
   std::map<int, long> fBLTCounter;
+  long fBLTsSaved; // by blt_sizing
+  long fBytesRead;
+  std::atomic_long fSkippedWords;
+  std::atomic_long fEventsRead, fMissedEvents, fMissedBytes;
+  long fWordsRead; // in events, for the average size
+  int fLastEventCounter; // -1 until the first event after a start
+  int64_t fBusySince; // board time in ns, -1 when not busy
+  std::atomic_long fBusyWall; // steady clock ns, 0 when not busy
+  std::atomic_long fDeadtime, fBusyIntervals;
+  // [start, end) ns of deadtime that goes out with the next data packet
+  std::vector<std::pair<int64_t, int64_t>> fPendingDeadtime;
 
   virtual int Init(int, int, std::shared_ptr<Options>&);
   bool MonitorRegister(uint32_t reg, uint32_t mask, int ntries, int sleep, uint32_t val=1);
-  virtual std::tuple<uint32_t, long> GetClockInfo(std::u32string_view);
-  virtual int GetClockCounter(uint32_t);
+  void TrackBusy(bool);
+  std::shared_ptr<VMEBackend> fVME;
   int fBoardHandle;
   int fBID;
   unsigned int fBaseAddress;
 
   // Stuff for clock reset tracking
-  int fRolloverCounter;
-  uint32_t fLastClock;
-  std::chrono::high_resolution_clock::time_point fLastClockTime;
-  std::chrono::nanoseconds fClockPeriod;
+  int64_t fLastTime; // of the last event we saw, in clock cycles
+  std::chrono::steady_clock::time_point fLastClockTime;
+  std::mutex fClockMutex; // for the two above once the run is going
 
   std::shared_ptr<MongoLog> fLog;
   std::atomic_bool fError;
 
   float fBLTSafety, fBufferSafety;
   int fSampleWidth, fClockCycle;
+  DigitizerFormats::Format fFormat; // kGeneric if the Unpack functions aren't in DigitizerFormats
+  const std::type_info* fFormatOwner; // the class that set fFormat
   int16_t fArtificialDeadtimeChannel;
 };
 
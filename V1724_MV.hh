@@ -9,7 +9,7 @@ public:
   V1724_MV(std::shared_ptr<MongoLog>&, std::shared_ptr<Options>&, int, int, int, unsigned);
   virtual ~V1724_MV();
 
-  virtual std::tuple<int64_t, int, uint16_t, std::u32string_view> UnpackChannelHeader(std::u32string_view, long, uint32_t, uint32_t, int, int);
+  virtual std::tuple<int64_t, int, uint16_t, std::u32string_view> UnpackChannelHeader(std::u32string_view, int64_t, int, int);
 
 protected:
 };
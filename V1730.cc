@@ -4,9 +4,11 @@
 
 V1730::V1730(std::shared_ptr<MongoLog>& log, std::shared_ptr<Options>& options, int link, int crate, int bid, unsigned address)
   :V1724(log, options, link, crate, bid, address){
-  fNChannels = 16;
-  fSampleWidth = 2;
-  fClockCycle = 2;
+  fNChannels = DigitizerFormats::V1730Format::kChannels;
+  fSampleWidth = DigitizerFormats::V1730Format::kSampleWidth;
+  fClockCycle = DigitizerFormats::V1730Format::kClockWidth;
+  fFormat = DigitizerFormats::kV1730;
+  fFormatOwner = &typeid(V1730);
   fArtificialDeadtimeChannel = 792;
 }
 
@@ -14,18 +16,14 @@ V1730::~V1730(){}
 
 std::tuple<int, int, bool, uint32_t> V1730::UnpackEventHeader(std::u32string_view sv) {
   // returns {words this event, channel mask, board fail, header timestamp}
-  return {sv[0]&0xFFFFFFF,
-         (sv[1]&0xFF) | ((sv[2]>>16)&0xFF00),
-          sv[1]&0x4000000,
-          sv[3]&0x7FFFFFFF};
+  auto h = DigitizerFormats::V1730Format::EventHeader(sv);
+  return {h.words, h.channel_mask, h.fail, h.time};
 }
 
 std::tuple<int64_t, int, uint16_t, std::u32string_view>
-V1730::UnpackChannelHeader(std::u32string_view sv, long, uint32_t, uint32_t, int, int) {
+V1730::UnpackChannelHeader(std::u32string_view sv, int64_t event_time,
+    int event_words, int n_channels) {
   // returns {timestamp (ns), words this channel, baseline, waveform}
-  int words = sv[0]&0x7FFFFF;
-  return {(long(sv[1]) | (long(sv[2]&0xFFFF)<<32))*fClockCycle,
-          words,
-          (sv[2]>>16)&0x3FFF,
-          sv.substr(3, words-3)};
+  auto h = DigitizerFormats::V1730Format::ChannelHeader(sv, event_time, event_words, n_channels);
+  return {h.timestamp, h.words, h.baseline, h.wf};
 }
@@ -1,8 +1,9 @@
 #include "V2718.hh"
 #include "MongoLog.hh"
-#include <CAENVMElib.h>
+#include "VMEBackend.hh"
 
-V2718::V2718(std::shared_ptr<MongoLog>& log, CrateOptions c_opts, int link, int crate){
+V2718::V2718(std::shared_ptr<MongoLog>& log, std::shared_ptr<Options>& opts, CrateOptions c_opts,
+    int link, int crate){
   fLog = log;
   fBoardHandle=-1;
 
@@ -11,8 +12,9 @@ V2718::V2718(std::shared_ptr<MongoLog>& log, CrateOptions c_opts, int link, int
   fCopts = c_opts;
 
   // Initialising the V2718 module via the specified optical link
-  int a = CAENVME_Init(cvV2718, fLink, fCrate, &fBoardHandle);
-  if(a != cvSuccess){
+  fVME = VMEBackend::Get(opts);
+  int a = fVME->Init(fLink, fCrate, fBoardHandle);
+  if(a != VMEBackend::kSuccess){
     fLog->Entry(MongoLog::Error, "Failed to init V2718 with CAEN error: %i", a);
     throw std::runtime_error("Could not init CC");
   }
@@ -27,30 +29,30 @@ int V2718::SendStartSignal(){
   // Straight copy from: https://github.com/coderdj/kodiaq
 
   // Line 0 : S-IN.
-  CAENVME_SetOutputConf(fCrate, cvOutput0, cvDirect, cvActiveHigh, cvManualSW);
+  fVME->SetOutputConf(fBoardHandle, 0, VMEBackend::kManual);
   // Line 1 : MV S-IN Logic
-  CAENVME_SetOutputConf(fCrate, cvOutput1, cvDirect, cvActiveHigh, cvManualSW);
+  fVME->SetOutputConf(fBoardHandle, 1, VMEBackend::kManual);
   // Line 2 : LED Logic
-  CAENVME_SetOutputConf(fCrate, cvOutput2, cvDirect, cvActiveHigh, cvManualSW);
+  fVME->SetOutputConf(fBoardHandle, 2, VMEBackend::kManual);
   // Line 3 : LED Pulser
-  CAENVME_SetOutputConf(fCrate, cvOutput3, cvDirect, cvActiveHigh, cvMiscSignals);
+  fVME->SetOutputConf(fBoardHandle, 3, VMEBackend::kMiscSignals);
   // Line 4 : NV S-IN Logic
-  CAENVME_SetOutputConf(fCrate, cvOutput4, cvDirect, cvActiveHigh, cvMiscSignals); // soonTM
+  fVME->SetOutputConf(fBoardHandle, 4, VMEBackend::kMiscSignals); // soonTM
 
 
   // Set the output register
   unsigned int data = 0x0;
   if(fCopts.neutron_veto)            //n_veto soonTM
-    data+=cvOut4Bit;
+    data+=1<<4;
   if(fCopts.led_trigger)
-    data+=cvOut2Bit;
+    data+=1<<2;
   if(fCopts.muon_veto)
-    data+=cvOut1Bit;
+    data+=1<<1;
   if(fCopts.s_in)
-    data+=cvOut0Bit;
+    data+=1<<0;
 
   // S-IN and logic signals 
-  if(CAENVME_SetOutputRegister(fCrate,data)!=0){
+  if(fVME->SetOutputRegister(fBoardHandle, data)!=0){
     fLog->Entry(MongoLog::Error, "Couldn't set output register to crate controller");
     return -1;
   }
@@ -60,10 +62,11 @@ int V2718::SendStartSignal(){
     //CAEN supports frequencies from 38 mHz to 40 MHz, but it's not continuous
     //We tell the CC about the time unit (104 ms, 410 us, 1.6 us, 25ns)
     //and how many of them (1-FF) to set the period
-    CVTimeUnits tu = cvUnit104ms;
+    VMEBackend::TimeUnit tu = VMEBackend::kUnit104ms;
     u_int32_t width = 0x1;
     u_int32_t period = 0x0;
-    std::vector<CVTimeUnits> tus = {cvUnit104ms, cvUnit410us, cvUnit1600ns, cvUnit25ns};
+    std::vector<VMEBackend::TimeUnit> tus = {VMEBackend::kUnit104ms, VMEBackend::kUnit410us,
+      VMEBackend::kUnit1600ns, VMEBackend::kUnit25ns};
     std::vector<double> widths = {104e-3, 410e-6, 1.6e-6, 25e-9};
 
     for (unsigned i = 0; i < widths.size(); i++) {
@@ -80,10 +83,7 @@ int V2718::SendStartSignal(){
       }
     }
     // Set pulser
-    int ret = CAENVME_SetPulserConf(fCrate, cvPulserB, period, width, tu, 0,
-                                    cvManualSW, cvManualSW);
-    ret *= CAENVME_StartPulser(fCrate,cvPulserB);
-    if(ret != cvSuccess){
+    if(fVME->StartPulser(fBoardHandle, period, width, tu) != VMEBackend::kSuccess){
       fLog->Entry(MongoLog::Warning, "Failed to activate LED pulser");
       return -1;
     }
@@ -97,27 +97,27 @@ int V2718::SendStopSignal(bool end){
     return 0;
 
   // Stop the pulser if it's running
-  CAENVME_StopPulser(fCrate, cvPulserB);
+  fVME->StopPulser(fBoardHandle);
   usleep(1000);
 
   // Line 0 : S-IN.
-  CAENVME_SetOutputConf(fCrate, cvOutput0, cvDirect, cvActiveHigh, cvManualSW);
+  fVME->SetOutputConf(fBoardHandle, 0, VMEBackend::kManual);
   // Line 1 : MV S-IN Logic
-  CAENVME_SetOutputConf(fCrate, cvOutput1, cvDirect, cvActiveHigh, cvManualSW);
+  fVME->SetOutputConf(fBoardHandle, 1, VMEBackend::kManual);
   // Line 2 : LED Logic
-  CAENVME_SetOutputConf(fCrate, cvOutput2, cvDirect, cvActiveHigh, cvManualSW);
+  fVME->SetOutputConf(fBoardHandle, 2, VMEBackend::kManual);
   // Line 3 : LED Pulser
-  CAENVME_SetOutputConf(fCrate, cvOutput3, cvDirect, cvActiveHigh, cvMiscSignals);
+  fVME->SetOutputConf(fBoardHandle, 3, VMEBackend::kMiscSignals);
   // Line 4 : NV S-IN Logic
-  CAENVME_SetOutputConf(fCrate, cvOutput4, cvDirect, cvActiveHigh, cvManualSW);
+  fVME->SetOutputConf(fBoardHandle, 4, VMEBackend::kManual);
 
 
   // Set the output register
   unsigned int data = 0x0;
-  CAENVME_SetOutputRegister(fCrate,data);
+  fVME->SetOutputRegister(fBoardHandle, data);
 
   if(end){
-    if(CAENVME_End(fCrate)!= cvSuccess){
+    if(fVME->End(fBoardHandle)!= VMEBackend::kSuccess){
       fLog->Entry(MongoLog::Warning, "Failed to end crate");
     }
     fBoardHandle=fLink=fCrate=-1;
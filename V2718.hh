@@ -4,10 +4,11 @@
 #include "Options.hh"
 
 class MongoLog;
+class VMEBackend;
 
 class V2718{
 public:
-  V2718(std::shared_ptr<MongoLog>&, CrateOptions, int, int);
+  V2718(std::shared_ptr<MongoLog>&, std::shared_ptr<Options>&, CrateOptions, int, int);
   virtual ~V2718();
 
   virtual int SendStartSignal();
@@ -17,6 +18,7 @@ public:
   int GetHandle(){return fBoardHandle;};
 
 protected:
+  std::shared_ptr<VMEBackend> fVME;
   int fBoardHandle;
   CrateOptions fCopts;
   int fCrate, fLink;
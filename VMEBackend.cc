@@ -0,0 +1,30 @@
+#include "VMEBackend.hh"
+#include "MockBackend.hh"
+#include "Options.hh"
+#include <mutex>
+#include <stdexcept>
+
+#ifndef REDAX_CAENVME
+#define REDAX_CAENVME 1
+#endif
+#if REDAX_CAENVME
+#include "CAENBackend.hh"
+#endif
+
+std::shared_ptr<VMEBackend> VMEBackend::Get(std::shared_ptr<Options>& opts) {
+  std::string which = opts->GetString("vme_backend", REDAX_CAENVME ? "caen" : "mock");
+  if (which == "mock") {
+    // Everyone has to see the same boards, so there's one for as long as
+    // anyone is using it
+    static std::mutex mutex;
+    static std::weak_ptr<MockBackend> instance;
+    const std::lock_guard<std::mutex> lg(mutex);
+    auto ret = instance.lock();
+    if (!ret) instance = ret = std::make_shared<MockBackend>(opts);
+    return ret;
+  }
+#if REDAX_CAENVME
+  if (which == "caen") return std::make_shared<CAENBackend>(); // no state, so no need to share
+#endif
+  throw std::runtime_error("No VME backend " + which + " in this build");
+}
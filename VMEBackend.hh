@@ -0,0 +1,54 @@
+#ifndef _VMEBACKEND_HH_
+#define _VMEBACKEND_HH_
+
+#include <cstdint>
+#include <memory>
+
+class Options;
+
+class VMEBackend{
+  /*
+    What the boards need from the VME bridge. Calls take the handle Init
+    gave out and full A32 addresses, and return the CAEN status codes (so
+    CAENBackend is a thin wrapper), 0 on success. Everything is D32 single
+    cycles except BLTRead, which is a FIFO MBLT: from one board's output
+    buffer, or from a whole chain of them at its CBLT address. The outputs and
+    the pulser are the V2718's own, there's one of each per handle. The
+    vme_backend option picks the implementation, MockBackend being the one
+    that works without any hardware.
+  */
+
+public:
+  enum Status {kSuccess = 0, kBusError = -1, kCommError = -2, kGenericError = -3};
+  // where a bridge output gets its level from
+  enum OutputSource {kManual = 0, kMiscSignals = 1};
+  // pulser period and width units, the order is CAEN's
+  enum TimeUnit {kUnit25ns = 0, kUnit1600ns = 1, kUnit410us = 2, kUnit104ms = 3};
+
+  virtual ~VMEBackend() {}
+
+  virtual int Init(int link, int crate, int& handle) = 0;
+  virtual int End(int handle) = 0;
+  virtual int ReadRegister(int handle, uint32_t address, uint32_t& value) = 0;
+  virtual int WriteRegister(int handle, uint32_t address, uint32_t value) = 0;
+  // Stops at size bytes or the first bus error, whichever comes first
+  virtual int BLTRead(int handle, uint32_t address, void* buffer, int size, int& bytes) = 0;
+
+  // IRQ lines are bits 0-6 of the mask, for levels 1-7
+  virtual int IRQEnable(int handle, uint32_t mask) = 0;
+  // kSuccess once one of them is asserted, something else after timeout_ms
+  virtual int IRQWait(int handle, uint32_t mask, uint32_t timeout_ms) = 0;
+
+  // Output 0-4, active high
+  virtual int SetOutputConf(int handle, int output, OutputSource) = 0;
+  // Bit i for output i, the ones set manually
+  virtual int SetOutputRegister(int handle, uint32_t outputs) = 0;
+  // Pulser B, period and width in units, started by software
+  virtual int StartPulser(int handle, uint32_t period, uint32_t width, TimeUnit) = 0;
+  virtual int StopPulser(int handle) = 0;
+
+  // The one to use with these options
+  static std::shared_ptr<VMEBackend> Get(std::shared_ptr<Options>&);
+};
+
+#endif // _VMEBACKEND_HH_ defined
@@ -0,0 +1,129 @@
+#include "WaveformFilter.hh"
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+long WaveformFilter::Encode(const char* in, long bytes, int fragment_bytes, std::string& out) {
+  // Appends the encoded block to out, returns how many bytes that was
+  if (fragment_bytes <= kStraxHeaderBytes || bytes % fragment_bytes != 0) return -1;
+  const int samples = (fragment_bytes - kStraxHeaderBytes)/sizeof(uint16_t);
+  const long n_frags = bytes / fragment_bytes;
+  size_t start = out.size();
+  out.resize(start + sizeof(filter_header_t) + bytes);
+  char* dest = out.data() + start;
+  filter_header_t fh{kMagic, kVersion, kStraxHeaderBytes, uint32_t(fragment_bytes),
+    uint32_t(n_frags)};
+  std::memcpy(dest, &fh, sizeof(fh));
+  char* headers = dest + sizeof(fh);
+  uint8_t* lo = (uint8_t*)headers + n_frags*kStraxHeaderBytes;
+  uint8_t* hi = lo + n_frags*samples;
+  uint16_t* wf = new uint16_t[samples];
+  for (long f = 0; f < n_frags; f++) {
+    const char* frag = in + f*fragment_bytes;
+    std::memcpy(headers + f*kStraxHeaderBytes, frag, kStraxHeaderBytes);
+    // the payload isn't necessarily 2-byte aligned in the input
+    std::memcpy(wf, frag + kStraxHeaderBytes, samples*sizeof(uint16_t));
+    EncodeSamples(wf, samples, lo + f*samples, hi + f*samples);
+  }
+  delete[] wf;
+  return sizeof(fh) + bytes;
+}
+
+long WaveformFilter::Decode(const char* in, long bytes, std::string& out) {
+  // Appends the original block to out, returns how many bytes that was
+  filter_header_t fh;
+  if (bytes < (long)sizeof(fh)) return -1;
+  std::memcpy(&fh, in, sizeof(fh));
+  if (fh.magic != kMagic || fh.version != kVersion || fh.header_bytes >= fh.fragment_bytes)
+    return -1;
+  const int samples = (fh.fragment_bytes - fh.header_bytes)/sizeof(uint16_t);
+  const long n_frags = fh.fragments, total = n_frags * fh.fragment_bytes;
+  if (bytes != (long)sizeof(fh) + total) return -1;
+  size_t start = out.size();
+  out.resize(start + total);
+  char* dest = out.data() + start;
+  const char* headers = in + sizeof(fh);
+  const uint8_t* lo = (const uint8_t*)headers + n_frags*fh.header_bytes;
+  const uint8_t* hi = lo + n_frags*samples;
+  uint16_t* wf = new uint16_t[samples];
+  for (long f = 0; f < n_frags; f++) {
+    char* frag = dest + f*fh.fragment_bytes;
+    std::memcpy(frag, headers + f*fh.header_bytes, fh.header_bytes);
+    DecodeSamples(lo + f*samples, hi + f*samples, samples, wf);
+    std::memcpy(frag + fh.header_bytes, wf, samples*sizeof(uint16_t));
+  }
+  delete[] wf;
+  return total;
+}
+
+bool WaveformFilter::IsFiltered(const char* in, long bytes) {
+  // the first word of an unfiltered block is a timestamp, so also check that
+  // the size adds up before trusting the magic number
+  filter_header_t fh;
+  if (bytes < (long)sizeof(fh)) return false;
+  std::memcpy(&fh, in, sizeof(fh));
+  return fh.magic == kMagic && bytes == long(sizeof(fh) + long(fh.fragments)*fh.fragment_bytes);
+}
+
+void WaveformFilter::EncodeSamples(const uint16_t* samples, int n, uint8_t* lo, uint8_t* hi) {
+  // delta, zigzag, split into bytes. Everything's mod 2^16 so it's exactly reversible
+  int i = 0;
+  uint16_t prev = 0;
+#ifdef __SSE2__
+  // 16 samples per iteration. The delta needs the previous sample, which is
+  // just an unaligned load one sample back (the first one is handled by hand)
+  const __m128i low_mask = _mm_set1_epi16(0xFF);
+  for (; i + 16 <= n; i += 16) {
+    __m128i cur0 = _mm_loadu_si128((const __m128i*)(samples + i));
+    __m128i cur1 = _mm_loadu_si128((const __m128i*)(samples + i + 8));
+    __m128i prev0 = i == 0 ? _mm_slli_si128(cur0, 2) :
+      _mm_loadu_si128((const __m128i*)(samples + i - 1));
+    __m128i prev1 = _mm_loadu_si128((const __m128i*)(samples + i + 7));
+    __m128i d0 = _mm_sub_epi16(cur0, prev0);
+    __m128i d1 = _mm_sub_epi16(cur1, prev1);
+    d0 = _mm_xor_si128(_mm_slli_epi16(d0, 1), _mm_srai_epi16(d0, 15));
+    d1 = _mm_xor_si128(_mm_slli_epi16(d1, 1), _mm_srai_epi16(d1, 15));
+    _mm_storeu_si128((__m128i*)(lo + i), _mm_packus_epi16(_mm_and_si128(d0, low_mask),
+          _mm_and_si128(d1, low_mask)));
+    _mm_storeu_si128((__m128i*)(hi + i), _mm_packus_epi16(_mm_srli_epi16(d0, 8),
+          _mm_srli_epi16(d1, 8)));
+  }
+  if (i > 0) prev = samples[i-1];
+#endif
+  for (; i < n; i++) {
+    int16_t d = int16_t(samples[i] - prev);
+    uint16_t z = uint16_t(d << 1) ^ uint16_t(d >> 15);
+    lo[i] = z & 0xFF;
+    hi[i] = z >> 8;
+    prev = samples[i];
+  }
+}
+
+void WaveformFilter::DecodeSamples(const uint8_t* lo, const uint8_t* hi, int n, uint16_t* samples) {
+  int i = 0;
+  uint16_t prev = 0;
+#ifdef __SSE2__
+  // prefix sum inside the register with shifts, then add the running total
+  const __m128i one = _mm_set1_epi16(1), zero = _mm_setzero_si128();
+  __m128i carry = zero;
+  for (; i + 8 <= n; i += 8) {
+    __m128i z = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(lo + i)),
+        _mm_loadl_epi64((const __m128i*)(hi + i)));
+    __m128i d = _mm_xor_si128(_mm_srli_epi16(z, 1), _mm_sub_epi16(zero, _mm_and_si128(z, one)));
+    d = _mm_add_epi16(d, _mm_slli_si128(d, 2));
+    d = _mm_add_epi16(d, _mm_slli_si128(d, 4));
+    d = _mm_add_epi16(d, _mm_slli_si128(d, 8));
+    d = _mm_add_epi16(d, carry);
+    _mm_storeu_si128((__m128i*)(samples + i), d);
+    carry = _mm_shufflehi_epi16(d, 0xFF);
+    carry = _mm_unpackhi_epi64(carry, carry);
+  }
+  if (i > 0) prev = samples[i-1];
+#endif
+  for (; i < n; i++) {
+    uint16_t z = lo[i] | (uint16_t(hi[i]) << 8);
+    prev += uint16_t((z >> 1) ^ -(z & 1));
+    samples[i] = prev;
+  }
+}
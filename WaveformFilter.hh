@@ -0,0 +1,42 @@
+#ifndef _WAVEFORMFILTER_HH_
+#define _WAVEFORMFILTER_HH_
+
+#include <cstdint>
+#include <string>
+
+class WaveformFilter{
+  /*
+    Reversible transform to run on a block of strax fragments before it goes
+    to the compressor. Headers are pulled out in front, and the samples of
+    each fragment are delta-coded, zigzagged (so small negative steps become
+    small positive numbers), and split into a plane of low bytes and a plane
+    of high bytes. Samples sitting near a flat baseline then turn into a low
+    plane of small numbers and a high plane of (almost) all zeros, which the
+    compressors like much better than interleaved raw samples.
+
+    [filter_header_t][headers of all fragments][low bytes][high bytes]
+  */
+
+public:
+  static long Encode(const char* in, long bytes, int fragment_bytes, std::string& out);
+  static long Decode(const char* in, long bytes, std::string& out);
+  // Whether a decompressed block went through Encode
+  static bool IsFiltered(const char* in, long bytes);
+
+  struct filter_header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_bytes; // strax header per fragment
+    uint32_t fragment_bytes; // strax header + payload
+    uint32_t fragments;
+  };
+  static const uint32_t kMagic = 0x46445852; // "RXDF"
+  static const uint16_t kVersion = 1;
+  static const int kStraxHeaderBytes = 24;
+
+private:
+  static void EncodeSamples(const uint16_t* samples, int n, uint8_t* lo, uint8_t* hi);
+  static void DecodeSamples(const uint8_t* lo, const uint8_t* hi, int n, uint16_t* samples);
+};
+
+#endif // _WAVEFORMFILTER_HH_ defined
@@ -0,0 +1,358 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cctype>
+#include <ctime>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <experimental/filesystem>
+#include <getopt.h>
+#include "StraxCodec.hh"
+#include "WaveformFilter.hh"
+
+// Reads back a run directory as written by the StraxFormatters, checks that the fragments
+// make sense, and reports how fast it all decompresses. With --compare it also recompresses
+// every file with other codec settings so they can be compared on real data.
+
+namespace fs=std::experimental::filesystem;
+
+struct fragment_t {
+  int64_t time;
+  int32_t length;
+  int16_t dt;
+  int16_t channel;
+  int32_t pulse_length;
+  uint16_t record_i;
+  int16_t baseline;
+};
+static_assert(sizeof(fragment_t) == WaveformFilter::kStraxHeaderBytes, "Strax header size mismatch");
+
+struct compare_setting_t {
+  std::string codec;
+  int level; // <0 for the codec's default
+  bool filter;
+  std::string label;
+};
+
+struct settings_t {
+  int fragment_bytes = 220 + WaveformFilter::kStraxHeaderBytes;
+  int min_channel = 0, max_channel = INT16_MAX;
+  unsigned max_messages = 20;
+  std::vector<compare_setting_t> compare;
+};
+
+struct compare_t {
+  long compressed = 0;
+  double comp_time = 0, decomp_time = 0;
+  long failures = 0;
+};
+
+struct reader_stats_t {
+  long files = 0, empty_files = 0, fragments = 0, compressed = 0, uncompressed = 0;
+  long continued = 0, unfinished = 0; // pulses split across files, not errors
+  double cpu_time = 0;
+  std::map<std::string, long> errors;
+  std::vector<std::string> messages;
+  std::map<std::string, compare_t> compare;
+
+  void Error(const std::string& type, const std::string& file, const std::string& what,
+      unsigned max_messages) {
+    errors[type]++;
+    if (messages.size() < max_messages) messages.push_back(file + ": " + what);
+  }
+  void Merge(const reader_stats_t& rhs) {
+    files += rhs.files;
+    empty_files += rhs.empty_files;
+    fragments += rhs.fragments;
+    compressed += rhs.compressed;
+    uncompressed += rhs.uncompressed;
+    continued += rhs.continued;
+    unfinished += rhs.unfinished;
+    cpu_time += rhs.cpu_time;
+    for (auto& [k, v] : rhs.errors) errors[k] += v;
+    messages.insert(messages.end(), rhs.messages.begin(), rhs.messages.end());
+    for (auto& [k, v] : rhs.compare) {
+      compare[k].compressed += v.compressed;
+      compare[k].comp_time += v.comp_time;
+      compare[k].decomp_time += v.decomp_time;
+      compare[k].failures += v.failures;
+    }
+  }
+};
+
+double ThreadTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+int PrintUsage() {
+  std::cout<<"Usage: chunk_reader [options] <run directory>\n"
+    << "--threads <n>: how many files to work on in parallel, default all cores\n"
+    << "--fragment-bytes <bytes>: strax_fragment_payload_bytes of the run, default 220\n"
+    << "--channels <min>:<max>: fragments outside this channel range are errors, default no limit\n"
+    << "--compare <setting,setting,...>: also recompress everything with these settings, which are\n"
+    << "    a compressor like \"lz4\" or \"blosc\", optionally with \"+delta_shuffle\"\n"
+    << "--levels <level,level,...>: compare each setting at each of these compression levels,\n"
+    << "    default only the compressor's own default\n"
+    << "--max-messages <n>: how many individual errors to print, default 20\n"
+    << "--help: print this message\n"
+    << "\n";
+  return 1;
+}
+
+std::vector<fs::path> ListChunkFiles(const fs::path& run_dir) {
+  // Chunk directories are all numbers (with _pre or _post), everything else
+  // (THE_END, metadata, leftover *_temp) isn't data
+  std::vector<fs::path> ret;
+  for (auto& dir : fs::directory_iterator(run_dir)) {
+    std::string name = dir.path().filename().string();
+    if (!fs::is_directory(dir.path()) || name.size() == 0 || !std::isdigit(name[0]) ||
+        name.find("_temp") != std::string::npos)
+      continue;
+    for (auto& file : fs::directory_iterator(dir.path()))
+      if (fs::is_regular_file(file.path())) ret.push_back(file.path());
+  }
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+void Verify(const std::string& data, const std::string& file, const settings_t& settings,
+    reader_stats_t& stats) {
+  // One file is the output of one formatter thread, which sees each board's data in
+  // order, so within a file every channel has to be in time order. Pulses can be split
+  // between files at the chunk boundaries, so those only count as errors inside a file
+  if (data.size() % settings.fragment_bytes != 0) {
+    stats.Error("size", file, std::to_string(data.size()) + " bytes isn't a whole number of fragments",
+        settings.max_messages);
+    return;
+  }
+  const int samples_per_fragment = (settings.fragment_bytes - sizeof(fragment_t))/sizeof(int16_t);
+  std::map<int16_t, fragment_t> last;
+  fragment_t frag;
+  for (size_t offset = 0; offset < data.size(); offset += settings.fragment_bytes) {
+    std::memcpy(&frag, data.data() + offset, sizeof(frag));
+    stats.fragments++;
+    std::string where = "fragment " + std::to_string(offset/settings.fragment_bytes) + " (ch " +
+      std::to_string(frag.channel) + ", t " + std::to_string(frag.time) + ")";
+    if (frag.channel < settings.min_channel || frag.channel > settings.max_channel)
+      stats.Error("channel range", file, where + " channel out of range", settings.max_messages);
+    if (frag.dt <= 0 || frag.length <= 0 || frag.length > samples_per_fragment ||
+        frag.pulse_length < frag.length)
+      stats.Error("header", file, where + " has dt " + std::to_string(frag.dt) + ", length " +
+          std::to_string(frag.length) + ", pulse length " + std::to_string(frag.pulse_length),
+          settings.max_messages);
+    auto it = last.find(frag.channel);
+    if (it == last.end()) {
+      if (frag.record_i > 0) stats.continued++;
+      last[frag.channel] = frag;
+      continue;
+    }
+    fragment_t& prev = it->second;
+    bool prev_finished = prev.pulse_length <= (prev.record_i+1)*samples_per_fragment;
+    if (frag.time < prev.time)
+      stats.Error("time order", file, where + " is earlier than the fragment before it at " +
+          std::to_string(prev.time), settings.max_messages);
+    if (frag.record_i > 0) {
+      if (prev_finished || frag.record_i != prev.record_i+1 || frag.pulse_length != prev.pulse_length)
+        stats.Error("record_i", file, where + " has record_i " + std::to_string(frag.record_i) +
+            " but the one before had " + std::to_string(prev.record_i), settings.max_messages);
+      else if (frag.time != prev.time + int64_t(samples_per_fragment)*prev.dt)
+        stats.Error("record time", file, where + " doesn't follow on from record " +
+            std::to_string(prev.record_i), settings.max_messages);
+    } else if (!prev_finished) {
+      stats.Error("record_i", file, where + " starts a new pulse but the last one stopped at record "
+          + std::to_string(prev.record_i), settings.max_messages);
+    }
+    prev = frag;
+  }
+  for (auto& [ch, frag] : last)
+    if (frag.pulse_length > (frag.record_i+1)*samples_per_fragment) stats.unfinished++;
+}
+
+void Compare(const std::string& data, const std::string& file, const settings_t& settings,
+    reader_stats_t& stats) {
+  std::string filtered, compressed, decompressed, restored;
+  for (auto& setting : settings.compare) {
+    auto& c = stats.compare[setting.label];
+    bool filter = setting.filter;
+    filtered.clear();
+    compressed.clear();
+    decompressed.clear();
+    restored.clear();
+    double t0 = ThreadTime();
+    const std::string* in = &data;
+    bool ok = true;
+    if (filter) {
+      ok &= WaveformFilter::Encode(data.data(), data.size(), settings.fragment_bytes, filtered) >= 0;
+      in = &filtered;
+    }
+    ok &= StraxCodec::Compress(setting.codec, setting.level, in->data(), in->size(),
+        compressed) >= 0;
+    double t1 = ThreadTime();
+    ok &= StraxCodec::Decompress(compressed.data(), compressed.size(), decompressed) >= 0;
+    if (filter)
+      ok &= WaveformFilter::Decode(decompressed.data(), decompressed.size(), restored) >= 0;
+    else
+      restored.swap(decompressed);
+    double t2 = ThreadTime();
+    if (!ok || restored != data) {
+      c.failures++;
+      stats.Error("compare", file, setting.label + " didn't round-trip", settings.max_messages);
+    }
+    c.compressed += compressed.size();
+    c.comp_time += t1-t0;
+    c.decomp_time += t2-t1;
+  }
+}
+
+void Worker(const std::vector<fs::path>& files, std::atomic_long& next, const settings_t& settings,
+    reader_stats_t& stats) {
+  std::string raw, data;
+  for (long i = next++; i < (long)files.size(); i = next++) {
+    std::string name = files[i].parent_path().filename().string() + "/" + files[i].filename().string();
+    std::ifstream fin(files[i], std::ios::binary);
+    std::stringstream ss;
+    ss << fin.rdbuf();
+    raw = ss.str();
+    data.clear();
+    stats.files++;
+    if (raw.size() == 0) {
+      stats.empty_files++;
+      continue;
+    }
+    double start = ThreadTime();
+    long ret = StraxCodec::DecodeChunk(raw.data(), raw.size(), data);
+    stats.cpu_time += ThreadTime() - start;
+    if (ret < 0) {
+      stats.Error("decompress", name, "couldn't decompress " + StraxCodec::Identify(raw.data(),
+            raw.size()) + " data", settings.max_messages);
+      continue;
+    }
+    stats.compressed += raw.size();
+    stats.uncompressed += data.size();
+    Verify(data, name, settings, stats);
+    if (settings.compare.size() > 0) Compare(data, name, settings, stats);
+  }
+}
+
+int main(int argc, char** argv) {
+  settings_t settings;
+  int threads = std::max(1u, std::thread::hardware_concurrency());
+  int c(0), opt_index;
+  struct option longopts[] = {
+    {"threads", required_argument, 0, c++},
+    {"fragment-bytes", required_argument, 0, c++},
+    {"channels", required_argument, 0, c++},
+    {"compare", required_argument, 0, c++},
+    {"levels", required_argument, 0, c++},
+    {"max-messages", required_argument, 0, c++},
+    {"help", no_argument, 0, c++},
+    {0, 0, 0, 0}
+  };
+  std::string arg;
+  std::vector<std::string> compare;
+  std::vector<int> levels;
+  while ((c = getopt_long(argc, argv, "", longopts, &opt_index)) != -1) {
+    switch (c) {
+      case 0:
+        threads = std::max(1, std::stoi(optarg)); break;
+      case 1:
+        settings.fragment_bytes = std::stoi(optarg) + sizeof(fragment_t); break;
+      case 2:
+        arg = optarg;
+        if (arg.find(':') == std::string::npos) return PrintUsage();
+        settings.min_channel = std::stoi(arg.substr(0, arg.find(':')));
+        settings.max_channel = std::stoi(arg.substr(arg.find(':')+1));
+        break;
+      case 3:
+        arg = optarg;
+        for (size_t pos = 0; pos <= arg.size(); ) {
+          size_t comma = std::min(arg.find(',', pos), arg.size());
+          if (comma > pos) compare.push_back(arg.substr(pos, comma-pos));
+          pos = comma+1;
+        }
+        break;
+      case 4:
+        arg = optarg;
+        for (size_t pos = 0; pos <= arg.size(); ) {
+          size_t comma = std::min(arg.find(',', pos), arg.size());
+          if (comma > pos) levels.push_back(std::stoi(arg.substr(pos, comma-pos)));
+          pos = comma+1;
+        }
+        break;
+      case 5:
+        settings.max_messages = std::stoi(optarg); break;
+      case 6:
+      default:
+        return PrintUsage();
+    }
+  }
+  if (levels.empty()) levels.push_back(-1);
+  for (auto& setting : compare) {
+    for (int level : levels) {
+      std::string label = setting + (level < 0 ? "" : " level " + std::to_string(level));
+      settings.compare.push_back({setting.substr(0, setting.find('+')), level,
+          setting.find("+delta_shuffle") != std::string::npos, label});
+    }
+  }
+  if (optind >= argc) return PrintUsage();
+  fs::path run_dir(argv[optind]);
+  if (!fs::is_directory(run_dir)) {
+    std::cout<<run_dir<<" isn't a directory\n";
+    return 1;
+  }
+  auto files = ListChunkFiles(run_dir);
+  std::cout<<"Reading "<<files.size()<<" files from "<<run_dir<<" with "<<threads<<" threads\n";
+
+  std::vector<reader_stats_t> thread_stats(threads);
+  std::vector<std::thread> workers;
+  std::atomic_long next = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < threads; i++)
+    workers.emplace_back(Worker, std::cref(files), std::ref(next), std::cref(settings),
+        std::ref(thread_stats[i]));
+  for (auto& t : workers) t.join();
+  double wall = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+  reader_stats_t stats;
+  for (auto& s : thread_stats) stats.Merge(s);
+
+  double mb = stats.uncompressed/1e6;
+  std::cout<<std::fixed<<std::setprecision(1)
+    <<"Files: "<<stats.files<<" ("<<stats.empty_files<<" empty)\n"
+    <<"Fragments: "<<stats.fragments<<"\n"
+    <<"Size: "<<stats.compressed/1e6<<" MB on disk, "<<mb<<" MB decompressed (ratio "
+    <<std::setprecision(2)<<(stats.compressed > 0 ? double(stats.uncompressed)/stats.compressed : 0)
+    <<")\n"<<std::setprecision(1)
+    <<"Decompression: "<<(stats.cpu_time > 0 ? mb/stats.cpu_time : 0)<<" MB/s per thread, "
+    <<mb/wall<<" MB/s overall (including reading and checking, "<<wall<<" s)\n"
+    <<"Pulses continuing from/into another file: "<<stats.continued<<"/"<<stats.unfinished<<"\n";
+
+  if (stats.compare.size() > 0) {
+    std::cout<<"\n"<<std::setw(32)<<"setting"<<std::setw(10)<<"ratio"<<std::setw(14)<<"comp MB/s"
+      <<std::setw(14)<<"decomp MB/s"<<"\n";
+    for (auto& setting : settings.compare) {
+      auto& c = stats.compare[setting.label];
+      std::cout<<std::setw(32)<<setting.label<<std::setprecision(2)<<std::setw(10)
+        <<(c.compressed > 0 ? double(stats.uncompressed)/c.compressed : 0)<<std::setprecision(1)
+        <<std::setw(14)<<(c.comp_time > 0 ? mb/c.comp_time : 0)
+        <<std::setw(14)<<(c.decomp_time > 0 ? mb/c.decomp_time : 0)
+        <<(c.failures > 0 ? "  FAILED round trip" : "")<<"\n";
+    }
+  }
+
+  long total_errors = 0;
+  for (auto& [type, n] : stats.errors) total_errors += n;
+  std::cout<<"\nErrors: "<<total_errors<<"\n";
+  for (auto& [type, n] : stats.errors) std::cout<<"  "<<type<<": "<<n<<"\n";
+  for (unsigned i = 0; i < std::min<size_t>(settings.max_messages, stats.messages.size()); i++)
+    std::cout<<"  "<<stats.messages[i]<<"\n";
+  return total_errors > 0 ? 1 : 0;
+}
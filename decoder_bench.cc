@@ -0,0 +1,209 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <tuple>
+#include <random>
+#include <chrono>
+#include <bitset>
+#include <type_traits>
+#include <getopt.h>
+#include "DigitizerFormats.hh"
+
+// Compares decoding synthetic data through the digitizers' virtual Unpack
+// functions (the way the StraxFormatter used to) with decoding through the
+// compile-time formats in DigitizerFormats.hh, for each board type. Only the
+// headers are decoded and the samples are touched (or summed with --work sum),
+// so this is the upper limit of what the specialization gains.
+
+using namespace DigitizerFormats;
+
+class Board {
+  // stand-in for the V1724 class hierarchy, virtual in the same places
+public:
+  virtual ~Board() {}
+  virtual std::tuple<int, int, bool, uint32_t> UnpackEventHeader(std::u32string_view) = 0;
+  virtual std::tuple<int64_t, int, uint16_t, std::u32string_view> UnpackChannelHeader(
+      std::u32string_view, int64_t, int, int) = 0;
+  virtual unsigned GetNumChannels() = 0;
+  virtual uint16_t SampleWidth() = 0;
+};
+
+template<typename Format>
+class BoardImpl : public Board {
+public:
+  std::tuple<int, int, bool, uint32_t> UnpackEventHeader(std::u32string_view sv) override {
+    auto h = Format::EventHeader(sv);
+    return {h.words, h.channel_mask, h.fail, h.time};
+  }
+  std::tuple<int64_t, int, uint16_t, std::u32string_view> UnpackChannelHeader(
+      std::u32string_view sv, int64_t et, int ew, int nc) override {
+    auto h = Format::ChannelHeader(sv, et, ew, nc);
+    return {h.timestamp, h.words, h.baseline, h.wf};
+  }
+  unsigned GetNumChannels() override {return Format::kChannels;}
+  uint16_t SampleWidth() override {return Format::kSampleWidth;}
+};
+
+struct settings_t {
+  int packets = 200, events = 100, samples = 110, repeat = 5;
+  double occupancy = 0.5;
+  bool sum = false;
+};
+
+template<typename Format>
+constexpr int ChannelHeaderWords() {
+  if constexpr (std::is_same_v<Format, V1730Format>) return 3;
+  else if constexpr (std::is_same_v<Format, V1724MVFormat>) return 0;
+  else return 2;
+}
+
+template<typename Format>
+std::u32string MakePacket(const settings_t& s, std::mt19937& gen) {
+  // events with random channel masks, in the board's format
+  std::u32string buff;
+  std::bernoulli_distribution hit(s.occupancy);
+  std::uniform_int_distribution<uint32_t> sample(0, 0x3FFF);
+  uint32_t time = gen() & 0x3FFFFFFF;
+  int words_per_channel = (s.samples+1)/2;
+  for (int ev = 0; ev < s.events; ev++) {
+    uint32_t mask = 0;
+    for (int ch = 0; ch < Format::kChannels; ch++) if (hit(gen)) mask |= 1 << ch;
+    if (mask == 0) mask = 1;
+    int n_ch = std::bitset<16>(mask).count();
+    const int header_words = ChannelHeaderWords<Format>();
+    int words = 4 + n_ch*(words_per_channel + header_words);
+    time += 1000;
+    buff += char32_t((0xAu<<28) | words);
+    buff += char32_t(mask & 0xFF);
+    buff += char32_t(((mask >> 8) << 24) | ev);
+    buff += char32_t(time & 0x7FFFFFFF);
+    for (int ch = 0; ch < n_ch; ch++) {
+      if (header_words == 2) {
+        buff += char32_t(words_per_channel + 2);
+        buff += char32_t((time + ch) & 0x7FFFFFFF);
+      } else if (header_words == 3) {
+        buff += char32_t(words_per_channel + 3);
+        buff += char32_t(time + ch);
+        buff += char32_t(16000u << 16);
+      }
+      for (int w = 0; w < words_per_channel; w++) buff += char32_t(sample(gen) | (sample(gen) << 16));
+    }
+  }
+  return buff;
+}
+
+template<typename Format>
+long Walk(const std::u32string& buff, const Format& fmt, bool sum) {
+  // same loops as StraxFormatter::ProcessPacket/ProcessEvent, returns something
+  // that depends on everything so the compiler can't skip any of it
+  long ret = 0;
+  for (auto it = buff.begin(); it < buff.end(); ) {
+    if ((*it)>>28 != 0xA) {it++; continue;}
+    std::u32string_view sv(buff.data() + (it - buff.begin()), (*it)&0xFFFFFFF);
+    auto header = fmt.EventHeader(sv);
+    it += header.words;
+    sv.remove_prefix(4);
+    int n_channels = std::bitset<16>(header.channel_mask).count();
+    for (unsigned ch = 0; ch < fmt.Channels(); ch++) {
+      if (!(header.channel_mask & (1<<ch))) continue;
+      auto channel = fmt.ChannelHeader(sv, header.time, header.words, n_channels);
+      ret += channel.timestamp + channel.baseline + fmt.SampleWidth()*channel.wf.size();
+      if (sum) {
+        const uint16_t* samples = (const uint16_t*)channel.wf.data();
+        for (unsigned i = 0; i < channel.wf.size()*2; i++) ret += samples[i];
+      } else if (channel.wf.size() > 0) {
+        ret += channel.wf[0];
+      }
+      sv.remove_prefix(channel.words);
+    }
+  }
+  return ret;
+}
+
+std::unique_ptr<Board> MakeBoard(const std::string& name) {
+  // picked at runtime so the calls really are virtual
+  if (name == "V1730") return std::make_unique<BoardImpl<V1730Format>>();
+  if (name == "V1724_MV") return std::make_unique<BoardImpl<V1724MVFormat>>();
+  return std::make_unique<BoardImpl<V1724Format>>();
+}
+
+template<typename Format>
+void Bench(const std::string& name, const settings_t& s) {
+  std::mt19937 gen(12345);
+  std::vector<std::u32string> packets;
+  long bytes = 0, channels = 0;
+  for (int p = 0; p < s.packets; p++) {
+    packets.push_back(MakePacket<Format>(s, gen));
+    bytes += packets.back().size()*sizeof(char32_t);
+  }
+  for (auto& p : packets) {
+    for (auto it = p.begin(); it < p.end(); it += (*it)&0xFFFFFFF)
+      channels += std::bitset<16>(Format::EventHeader(std::u32string_view(&*it, 4)).channel_mask).count();
+  }
+  auto board = MakeBoard(name);
+  GenericFormat<Board> virt(board.get());
+  Format spec;
+  long check[2] = {0, 0};
+  double best[2] = {1e99, 1e99};
+  for (int r = 0; r < s.repeat; r++) {
+    for (int i = 0; i < 2; i++) {
+      long c = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (auto& p : packets) c += i == 0 ? Walk(p, virt, s.sum) : Walk(p, spec, s.sum);
+      double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      best[i] = std::min(best[i], t);
+      check[i] = c;
+    }
+  }
+  if (check[0] != check[1])
+    std::cout << name << ": decoders disagree (" << check[0] << " vs " << check[1] << ")\n";
+  for (int i = 0; i < 2; i++) {
+    std::cout << std::setw(10) << name << std::setw(12) << (i == 0 ? "virtual" : "templated") <<
+      std::fixed << std::setprecision(1) << std::setw(10) << bytes/best[i]/1e6 << " MB/s" <<
+      std::setprecision(2) << std::setw(10) << best[i]*1e9/channels << " ns/channel";
+    if (i == 1) std::cout << std::setprecision(2) << std::setw(8) << best[0]/best[1] << "x";
+    std::cout << '\n';
+  }
+}
+
+void Usage() {
+  std::cout << "Usage: decoder_bench [options]\n"
+    << "  --packets N     packets per board type (200)\n"
+    << "  --events N      events per packet (100)\n"
+    << "  --samples N     samples per channel (110)\n"
+    << "  --occupancy F   fraction of channels in each event (0.5)\n"
+    << "  --repeat N      take the best of this many passes (5)\n"
+    << "  --work sum      sum every sample instead of just touching the waveform\n";
+}
+
+int main(int argc, char** argv) {
+  settings_t s;
+  struct option longopts[] = {
+    {"packets", required_argument, 0, 'p'},
+    {"events", required_argument, 0, 'e'},
+    {"samples", required_argument, 0, 's'},
+    {"occupancy", required_argument, 0, 'o'},
+    {"repeat", required_argument, 0, 'r'},
+    {"work", required_argument, 0, 'w'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+  };
+  int c, i;
+  while ((c = getopt_long(argc, argv, "p:e:s:o:r:w:h", longopts, &i)) != -1) {
+    switch (c) {
+      case 'p': s.packets = std::max(1, std::stoi(optarg)); break;
+      case 'e': s.events = std::max(1, std::stoi(optarg)); break;
+      case 's': s.samples = std::max(2, std::stoi(optarg)); break;
+      case 'o': s.occupancy = std::stod(optarg); break;
+      case 'r': s.repeat = std::max(1, std::stoi(optarg)); break;
+      case 'w': s.sum = std::string(optarg) == "sum"; break;
+      default: Usage(); return 0;
+    }
+  }
+  Bench<V1724Format>("V1724", s);
+  Bench<V1730Format>("V1730", s);
+  Bench<V1724MVFormat>("V1724_MV", s);
+  return 0;
+}
@@ -54,8 +54,8 @@ f1724::f1724(std::shared_ptr<MongoLog>& log, std::shared_ptr<Options>& opts, int
     7.75, 4.46, 3.68, 3.31, 2.97, 2.74, 2.66, 2.48, 2.27, 2.15, 2.03, 1.93, 1.70,
     1.68, 1.26, 7.86e-1, 5.36e-1, 4.36e-1, 3.11e-1, 2.15e-1};
   fEventCounter = 0;
-  fSeenUnder5 = true;
-  fSeenOver15 = false;
+  // makes V1724 data, the V1724 decoder is fine
+  fFormatOwner = &typeid(f1724);
 }
 
 f1724::~f1724() {
@@ -112,8 +112,8 @@ int f1724::Read(std::unique_ptr<data_packet>& outptr) {
   if (fBufferSize == 0) return 0;
   const std::lock_guard<std::mutex> lk(fBufferMutex);
   int retwords = fBuffer.size();
-  auto [ht, cc] = GetClockInfo(fBuffer);
-  outptr = std::make_unique<data_packet>(std::move(fBuffer), ht, cc);
+  fBytesRead += retwords*sizeof(char32_t);
+  outptr = std::make_unique<data_packet>(std::move(fBuffer));
   fBufferSize = 0;
   return retwords;
 }
@@ -170,7 +170,7 @@ uint32_t f1724::GetAcquisitionStatus() {
 }
 
 int f1724::SoftwareStart() {
-  fLastClockTime = std::chrono::high_resolution_clock::now();
+  fLastClockTime = std::chrono::steady_clock::now();
   if (sReady == true) {
     sRun = true;
     sReady = false;
@@ -202,59 +202,6 @@ int f1724::Reset() {
   return 0;
 }
 
-int f1724::GetClockCounter(uint32_t timestamp) {
-  // Waveform generation is asynchronous, so we need different logic here
-  // from a hardware digitizer
-  if (timestamp > fLastClock) {
-    // Case 1. This is over 15s but fSeenUnder5 is true. Give 1 back
-    if(timestamp >= 15e8 && fSeenUnder5 && fRolloverCounter != 0)
-      return fRolloverCounter-1;
-
-    // Case 2. This is over 5s and fSeenUnder5 is true.
-    else if(fSeenUnder5 && 5e8 <= timestamp && timestamp < 15e8){
-      fSeenUnder5 = false;
-      fLastClock = timestamp;
-      return fRolloverCounter;
-    }
-
-    // Case 3. This is over 15s and fSeenUnder5 is false
-    else if(timestamp >= 15e8 && !fSeenUnder5){
-      fSeenOver15 = true;
-      fLastClock = timestamp;
-      return fRolloverCounter;
-    }
-
-    // Case 4. Anything else where the clock is progressing correctly
-    else{
-      fLastClock = timestamp;
-      return fRolloverCounter;
-    }
-  }
-
-  // Second, is this number less than the previous?
-  else if(timestamp < fLastClock){
-
-    // Case 1. Genuine clock reset. under 5s is false and over 15s is true
-    if(timestamp < 5e8 && !fSeenUnder5 && fSeenOver15){
-      fSeenUnder5 = true;
-      fSeenOver15 = false;
-      fLog->Entry(MongoLog::Local, "Bd %i rollover %i (%x/%x)",
-              fBID, fRolloverCounter, timestamp, fLastClock);
-      fLastClock = timestamp;
-      fRolloverCounter++;
-      return fRolloverCounter;
-    }
-
-    // Case 2: Any other jitter within the 21 seconds, just return
-    else{
-      return fRolloverCounter;
-    }
-  }
-  // timestamps are the same???
-  else
-    return fRolloverCounter;
-}
-
 std::tuple<double, double, double> f1724::GenerateEventLocation() {
   double offset = 0.5; // min number of PMTs between S1 and S2 to prevent overlap
   double z = -1.*sFlatDist(sGen)*((2*sFaxOptions.tpc_size+1)-offset)-offset;
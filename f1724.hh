@@ -68,7 +68,6 @@ protected:
 
   virtual int Init(int, int, std::shared_ptr<Options>&);
   void Run();
-  virtual int GetClockCounter(uint32_t);
   void MakeWaveform(std::vector<hit_t>&, long);
   void ConvertToDigiFormat(const std::vector<std::vector<double>>&, int, long);
   std::vector<std::vector<double>> GenerateNoise(int, int=0xFF);
@@ -91,8 +90,6 @@ protected:
   std::condition_variable fCV;
   std::mutex fMutex;
   std::thread fGeneratorThread;
-
-  bool fSeenUnder5, fSeenOver15;
 };
 
 #endif // _F1724_HH_ defined
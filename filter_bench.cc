@@ -0,0 +1,118 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <getopt.h>
+#include "StraxCodec.hh"
+#include "WaveformFilter.hh"
+
+// Compression ratio vs speed of the codec and prefilter combinations on recorded chunks.
+// Every combination is decoded again and compared to the input, so this doubles as a
+// check that the filter round-trips on real data
+
+int PrintUsage() {
+  std::cout<<"Usage: filter_bench [options] <chunk file> [<chunk file> ...]\n"
+    << "--fragment-bytes <bytes>: strax_fragment_payload_bytes of the run, default 220\n"
+    << "--repeat <n>: how many times to repeat each measurement, default 5\n"
+    << "--level <n>: compression level for both codecs, default each one's own default\n"
+    << "--help: print this message\n"
+    << "\n";
+  return 1;
+}
+
+bool ReadChunk(const std::string& filename, std::string& out) {
+  // Decompresses a chunk as written by the formatter, whatever its layout or filter
+  std::ifstream fin(filename, std::ios::binary);
+  if (!fin.is_open()) return false;
+  std::stringstream ss;
+  ss << fin.rdbuf();
+  std::string raw = ss.str();
+  return StraxCodec::DecodeChunk(raw.data(), raw.size(), out) >= 0;
+}
+
+int main(int argc, char** argv) {
+  using namespace std::chrono;
+  int fragment_bytes = 220 + WaveformFilter::kStraxHeaderBytes, repeat = 5, level = -1;
+  int c(0), opt_index;
+  struct option longopts[] = {
+    {"fragment-bytes", required_argument, 0, 0},
+    {"repeat", required_argument, 0, 1},
+    {"level", required_argument, 0, 2},
+    {"help", no_argument, 0, 3},
+    {0, 0, 0, 0}
+  };
+  while ((c = getopt_long(argc, argv, "", longopts, &opt_index)) != -1) {
+    switch (c) {
+      case 0:
+        fragment_bytes = std::stoi(optarg) + WaveformFilter::kStraxHeaderBytes; break;
+      case 1:
+        repeat = std::max(1, std::stoi(optarg)); break;
+      case 2:
+        level = std::stoi(optarg); break;
+      case 3:
+      default:
+        return PrintUsage();
+    }
+  }
+  if (optind >= argc) return PrintUsage();
+
+  std::string data;
+  for (int i = optind; i < argc; i++) {
+    if (!ReadChunk(argv[i], data)) {
+      std::cout<<"Couldn't read "<<argv[i]<<"\n";
+      return 1;
+    }
+  }
+  if (data.size() == 0 || data.size() % fragment_bytes != 0) {
+    std::cout<<"Read "<<data.size()<<" bytes, not a multiple of "<<fragment_bytes
+      <<", check --fragment-bytes\n";
+    return 1;
+  }
+  std::cout<<"Read "<<data.size()/fragment_bytes<<" fragments ("<<data.size()<<" bytes)\n\n";
+  std::cout<<std::setw(8)<<"codec"<<std::setw(16)<<"prefilter"<<std::setw(10)<<"ratio"
+    <<std::setw(14)<<"comp MB/s"<<std::setw(14)<<"decomp MB/s"<<"\n";
+
+  for (std::string codec : {"lz4", "blosc"}) {
+    for (std::string filter : {"none", "delta_shuffle"}) {
+      std::string filtered, compressed, decompressed, restored;
+      double t_comp(0), t_decomp(0);
+      bool ok = true;
+      for (int r = 0; r < repeat && ok; r++) {
+        filtered.clear();
+        compressed.clear();
+        decompressed.clear();
+        restored.clear();
+        auto t0 = high_resolution_clock::now();
+        const std::string* in = &data;
+        if (filter == "delta_shuffle") {
+          WaveformFilter::Encode(data.data(), data.size(), fragment_bytes, filtered);
+          in = &filtered;
+        }
+        ok &= StraxCodec::Compress(codec, level, in->data(), in->size(), compressed) >= 0;
+        auto t1 = high_resolution_clock::now();
+        ok &= StraxCodec::Decompress(compressed.data(), compressed.size(), decompressed) >= 0;
+        if (filter == "delta_shuffle")
+          ok &= WaveformFilter::Decode(decompressed.data(), decompressed.size(), restored) >= 0;
+        else
+          restored.swap(decompressed);
+        auto t2 = high_resolution_clock::now();
+        ok &= restored == data;
+        t_comp += duration_cast<duration<double>>(t1-t0).count();
+        t_decomp += duration_cast<duration<double>>(t2-t1).count();
+      }
+      std::cout<<std::setw(8)<<codec<<std::setw(16)<<filter;
+      if (!ok) {
+        std::cout<<"  FAILED round trip\n";
+        return 1;
+      }
+      double mb = data.size()*repeat/1e6;
+      std::cout<<std::fixed<<std::setprecision(2)<<std::setw(10)
+        <<double(data.size())/compressed.size()<<std::setprecision(1)
+        <<std::setw(14)<<mb/t_comp<<std::setw(14)<<mb/t_decomp<<"\n";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,75 @@
+import struct
+import argparse
+from collections import defaultdict
+
+# Have to match RawCapture::file_header_t and record_header_t
+FILE_HEADER = struct.Struct('=QIIiI')
+RECORD_HEADER = struct.Struct('=QqqiIII')
+MAGIC = 0x5245444158524157
+
+
+def records(filename):
+    """Yields (header dict, data as bytes) for each readout in a raw capture"""
+    with open(filename, 'rb') as f:
+        magic, version, header_size, link, record_header_size = FILE_HEADER.unpack(
+                f.read(FILE_HEADER.size))
+        if magic != MAGIC:
+            raise ValueError('%s is not a raw capture' % filename)
+        f.seek(header_size)
+        while True:
+            buf = f.read(record_header_size)
+            if len(buf) < record_header_size:
+                return
+            seq, read_time, clock, bid, fmt, clock_width, words = RECORD_HEADER.unpack(
+                    buf[:RECORD_HEADER.size])
+            data = f.read(words*4)
+            f.read((8 - words*4 % 8) % 8)
+            yield dict(link=link, sequence=seq, read_time=read_time, clock=clock, bid=bid,
+                    format=fmt, clock_width=clock_width, words=words), data
+
+
+def count_events(data):
+    """Event headers the way HeaderScan finds them, skipping junk between events"""
+    words = struct.unpack('<%iI' % (len(data)//4), data)
+    n, i = 0, 0
+    while i < len(words):
+        size = words[i] & 0xFFFFFFF
+        if words[i] >> 28 == 0xA and 4 <= size <= len(words) - i:
+            n += 1
+            i += size
+        else:
+            i += 1
+    return n
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Summarize a redax raw capture (raw_capture_path)')
+    parser.add_argument('file', help='A capture file, RUN_HOST_linkN.raw')
+    parser.add_argument('--events', action='store_true', help='Also count the events in each readout')
+    args = parser.parse_args()
+
+    boards = defaultdict(lambda: dict(reads=0, bytes=0, events=0, first=None, last=None))
+    expected, gaps, lost = 0, 0, 0
+    for header, data in records(args.file):
+        if header['sequence'] != expected:
+            gaps += 1
+            lost += header['sequence'] - expected
+        expected = header['sequence'] + 1
+        b = boards[header['bid']]
+        b['reads'] += 1
+        b['bytes'] += len(data)
+        if args.events:
+            b['events'] += count_events(data)
+        if b['first'] is None:
+            b['first'] = header['read_time']
+        b['last'] = header['read_time']
+    for bid, b in sorted(boards.items()):
+        dt = (b['last'] - b['first'])/1e9
+        print('Board %i: %i readouts, %.1f MB%s over %.1f s' % (bid, b['reads'], b['bytes']/1e6,
+            ', %i events' % b['events'] if args.events else '', dt))
+    print('%i readouts dropped in %i gaps' % (lost, gaps))
+    return
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,63 @@
+import os
+import socket
+import struct
+import argparse
+import time
+
+# Has to match ChunkStreamer::frame_header_t
+HEADER = struct.Struct('=IIIIQQ')
+MAGIC = 0x52445853
+
+
+def recv_exactly(sock, n):
+    buf = bytearray()
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            raise ConnectionError('redax closed the stream')
+        buf += chunk
+    return bytes(buf)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Minimal consumer for redax chunk streaming')
+    parser.add_argument('--socket', required=True, help='The stream_socket_path from the run mode')
+    parser.add_argument('--credits', type=int, default=1,
+            help='How many chunks to ask for up front. Only ask for what you can read immediately')
+    parser.add_argument('--output', help='Write chunks into this directory, like redax would')
+    parser.add_argument('--delay', type=float, default=0, help='Seconds to sleep per chunk, to play a slow consumer')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(args.socket)
+    sock.sendall(struct.pack('=I', args.credits))
+    n_chunks, n_bytes, t_start = 0, 0, time.time()
+    try:
+        while True:
+            magic, version, name_len, host_len, size, uncompressed = HEADER.unpack(
+                    recv_exactly(sock, HEADER.size))
+            if magic != MAGIC:
+                raise ValueError('Lost framing (magic %x, version %i)' % (magic, version))
+            name = recv_exactly(sock, name_len).decode()
+            host = recv_exactly(sock, host_len).decode()
+            payload = recv_exactly(sock, size)
+            if args.output:
+                os.makedirs(os.path.join(args.output, name), exist_ok=True)
+                with open(os.path.join(args.output, name, host), 'wb') as f:
+                    f.write(payload)
+            n_chunks += 1
+            n_bytes += size
+            print('%s from %s: %i bytes (%i uncompressed)' % (name, host, size, uncompressed))
+            if args.delay > 0:
+                time.sleep(args.delay)
+            # done with this one, so redax can send another
+            sock.sendall(struct.pack('=I', 1))
+    except (ConnectionError, KeyboardInterrupt) as e:
+        print(e)
+    dt = time.time() - t_start
+    print('Got %i chunks, %.1f MB in %.1f s' % (n_chunks, n_bytes/1e6, dt))
+    return
+
+
+if __name__ == '__main__':
+    main()
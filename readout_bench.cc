@@ -0,0 +1,171 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <experimental/filesystem>
+#include <getopt.h>
+#include <bsoncxx/json.hpp>
+#include <bsoncxx/builder/basic/document.hpp>
+#include "DAQController.hh"
+#include "Options.hh"
+#include "MongoLog.hh"
+
+// Runs the readout the way redax does (arm, start, stop), but against the
+// mock VME backend and with the options from the command line instead of the
+// database, then prints what the performance report says about it. So
+// ReadData, the CBLT chains, the scheduler etc can be timed on any box.
+// Everything in --options goes on top of the generated run mode, e.g.
+// '{"mock_bandwidth_mb": 200, "read_priority": 1}'
+
+struct settings_t {
+  int links = 1, boards = 4, per_crate = 1, threads = 4;
+  double seconds = 10, rate = 1000;
+  std::string type = "V1724", output = "/tmp/readout_bench", options = "{}";
+  bool cblt = false, async = false, json = false;
+};
+
+void Usage() {
+  std::cout<<"Usage: readout_bench [options]\n"
+    << "--links <n>: optical links, default 1\n"
+    << "--boards <n>: boards per link, default 4\n"
+    << "--per-crate <n>: boards per crate (per CBLT chain), default 1\n"
+    << "--type <type>: V1724, V1730 or V1724_MV, default V1724\n"
+    << "--rate <Hz>: triggers per board per second, default 1000\n"
+    << "--seconds <s>: how long to run, default 10\n"
+    << "--threads <n>: processing threads, default 4\n"
+    << "--cblt: read each crate with chained block transfers\n"
+    << "--async: readout_async\n"
+    << "--output <dir>: for the strax output and the log, default /tmp/readout_bench\n"
+    << "--options <json>: more options, these win over everything above\n"
+    << "--json: print the whole performance report\n"
+    << "--help: print this message\n"
+    << "\n";
+}
+
+std::string RunMode(const settings_t& s, const std::string& host) {
+  std::stringstream boards, channels;
+  int channel = 0, nch = s.type == "V1730" ? 16 : 8;
+  for (int link = 0; link < s.links; link++) {
+    for (int i = 0; i < s.boards; i++) {
+      int bid = 100*(link+1) + i;
+      boards << (boards.tellp() > 0 ? "," : "") << "{\"link\":" << link << ",\"crate\":" <<
+        i/s.per_crate << ",\"board\":" << bid << ",\"type\":\"" << s.type <<
+        "\",\"vme_address\":\"" << std::hex << 0x80000000 + (i%s.per_crate)*0x10000 <<
+        std::dec << "\"}";
+      channels << (channels.tellp() > 0 ? "," : "") << "\"" << bid << "\":[";
+      for (int ch = 0; ch < nch; ch++) channels << (ch ? "," : "") << channel++;
+      channels << "]";
+    }
+  }
+  std::stringstream mode;
+  mode << "{\"name\":\"readout_bench\",\"detectors\":{\"" << host << "\":\"bench\"}," <<
+    "\"boards\":[" << boards.str() << "],\"registers\":[],\"channels\":{" << channels.str() <<
+    "},\"processing_threads\":{\"" << host << "\":" << s.threads << "}," <<
+    "\"strax_output_path\":\"" << s.output << "\",\"baseline_dac_mode\":\"fixed\"," <<
+    "\"run_start\":0,\"vme_backend\":\"mock\",\"mock_event_rate\":" << s.rate <<
+    ",\"cblt\":" << s.cblt << ",\"readout_async\":" << s.async << "}";
+  return mode.str();
+}
+
+std::string Merge(const std::string& base, const std::string& extra) {
+  // top-level fields of extra replace those of base
+  using bsoncxx::builder::basic::kvp;
+  auto b = bsoncxx::from_json(base), e = bsoncxx::from_json(extra);
+  bsoncxx::builder::basic::document doc;
+  for (auto el : b.view())
+    if (e.view().find(el.key()) == e.view().end()) doc.append(kvp(el.key(), el.get_value()));
+  for (auto el : e.view()) doc.append(kvp(el.key(), el.get_value()));
+  return bsoncxx::to_json(doc.view());
+}
+
+void PrintReport(bsoncxx::document::view report) {
+  std::cout<<"\n"<<std::setw(8)<<"board"<<std::setw(6)<<"link"<<std::setw(10)<<"MB/s"
+    <<std::setw(12)<<"events/s"<<std::setw(10)<<"missed"<<std::setw(10)<<"reads"
+    <<std::setw(11)<<"BLTs/read"<<std::setw(13)<<"max wait ms"<<"\n";
+  double seconds = report["seconds"].get_double();
+  for (auto el : report["boards"].get_document().view()) {
+    auto b = el.get_document().view();
+    long reads = b["reads"].get_int64(), blts = b["blts"].get_int64();
+    std::cout<<std::setw(8)<<el.key().to_string()<<std::setw(6)<<b["link"].get_int32().value
+      <<std::fixed<<std::setprecision(1)<<std::setw(10)<<b["mb_per_s"].get_double().value
+      <<std::setw(12)<<(seconds > 0 ? b["events"].get_int64()/seconds : 0.)
+      <<std::setw(10)<<b["missed_events"].get_int64().value<<std::setw(10)<<reads
+      <<std::setprecision(2)<<std::setw(11)<<(reads > 0 ? double(blts)/reads : 0.)
+      <<std::setprecision(1)<<std::setw(13)<<b["max_read_wait_ms"].get_double().value<<"\n";
+  }
+  std::cout<<"\n";
+  for (auto el : report["links"].get_document().view()) {
+    auto l = el.get_document().view();
+    std::cout<<"Link "<<el.key().to_string()<<": busy "<<std::setprecision(1)
+      <<100*l["utilization"].get_double().value<<"% of "<<seconds<<" s, queue full "
+      <<l["queue_full"].get_int64().value<<" times\n";
+  }
+}
+
+int main(int argc, char** argv) {
+  settings_t s;
+  struct option longopts[] = {
+    {"links", required_argument, 0, 'l'},
+    {"boards", required_argument, 0, 'b'},
+    {"per-crate", required_argument, 0, 'c'},
+    {"type", required_argument, 0, 't'},
+    {"rate", required_argument, 0, 'r'},
+    {"seconds", required_argument, 0, 's'},
+    {"threads", required_argument, 0, 'p'},
+    {"cblt", no_argument, 0, 'C'},
+    {"async", no_argument, 0, 'a'},
+    {"output", required_argument, 0, 'o'},
+    {"options", required_argument, 0, 'O'},
+    {"json", no_argument, 0, 'j'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+  };
+  int c, i;
+  while ((c = getopt_long(argc, argv, "", longopts, &i)) != -1) {
+    switch (c) {
+      case 'l': s.links = std::max(1, std::stoi(optarg)); break;
+      case 'b': s.boards = std::max(1, std::stoi(optarg)); break;
+      case 'c': s.per_crate = std::max(1, std::stoi(optarg)); break;
+      case 't': s.type = optarg; break;
+      case 'r': s.rate = std::stod(optarg); break;
+      case 's': s.seconds = std::stod(optarg); break;
+      case 'p': s.threads = std::max(1, std::stoi(optarg)); break;
+      case 'C': s.cblt = true; break;
+      case 'a': s.async = true; break;
+      case 'o': s.output = optarg; break;
+      case 'O': s.options = optarg; break;
+      case 'j': s.json = true; break;
+      default: Usage(); return 0;
+    }
+  }
+  std::string host = "readout_bench";
+  std::experimental::filesystem::create_directories(s.output);
+  std::shared_ptr<mongocxx::pool> no_db;
+  auto log = std::make_shared<MongoLog>(1, no_db, "", s.output, host);
+  std::shared_ptr<Options> options;
+  try {
+    options = std::make_shared<Options>(log, Merge(RunMode(s, host), s.options), host);
+  } catch (const std::exception& e) {
+    std::cout<<"Bad options: "<<e.what()<<"\n";
+    return 1;
+  }
+  DAQController controller(log, host);
+  if (controller.Arm(options) || controller.Start()) {
+    std::cout<<"Couldn't get the readout going, see the log\n";
+    controller.Stop();
+    return 1;
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(s.seconds));
+  controller.Stop();
+  auto report = options->GetBenchmarks();
+  if (report == nullptr) {
+    std::cout<<"No performance report, is performance_report off?\n";
+    return 1;
+  }
+  if (s.json) std::cout<<bsoncxx::to_json(report->view())<<"\n";
+  PrintReport(report->view());
+  return 0;
+}